@@ -0,0 +1,117 @@
+#include "BusWatch.h"
+
+#include <mutex>
+
+#include <CxxPtr/GstPtr.h>
+
+
+struct BusWatch::Watch
+{
+    WorkerHandler workerHandler;
+    MainHandler mainHandler;
+
+    std::mutex mutex;
+    GSource* source = nullptr;
+    bool removed = false;
+};
+
+struct BusWatch::ForwardedMessage
+{
+    std::weak_ptr<Watch> watch;
+    GstMessage* message;
+};
+
+
+BusWatch::~BusWatch()
+{
+    remove();
+}
+
+void BusWatch::add(
+    GstElement* pipeline,
+    GMainContext* context,
+    const WorkerHandler& workerHandler,
+    const MainHandler& mainHandler) noexcept
+{
+    remove();
+
+    // every add gets own Watch, so messages forwarded from
+    // previous pipeline are not delivered after remove()
+    std::shared_ptr<Watch> watch = std::make_shared<Watch>();
+    watch->workerHandler = workerHandler;
+    watch->mainHandler = mainHandler;
+
+    auto onMainMessageCallback =
+        [] (gpointer userData) -> gboolean {
+            ForwardedMessage* forwarded = static_cast<ForwardedMessage*>(userData);
+
+            // removed flag is changed from the main context only
+            std::shared_ptr<Watch> watch = forwarded->watch.lock();
+            if(watch && !watch->removed)
+                watch->mainHandler(forwarded->message); // could destroy BusWatch
+
+            return G_SOURCE_REMOVE;
+        };
+    auto onBusMessageCallback =
+        (gboolean (*) (GstBus*, GstMessage*, gpointer))
+        [] (GstBus* bus, GstMessage* message, gpointer userData) -> gboolean
+    {
+        std::shared_ptr<Watch>& watch = *static_cast<std::shared_ptr<Watch>*>(userData);
+
+        {
+            // remove() waits for running handler to complete
+            std::lock_guard<std::mutex> lock(watch->mutex);
+            if(watch->removed)
+                return G_SOURCE_REMOVE;
+
+            if(!watch->workerHandler(message))
+                return G_SOURCE_CONTINUE;
+        }
+
+        g_idle_add_full(
+            G_PRIORITY_DEFAULT,
+            GSourceFunc(onMainMessageCallback),
+            new ForwardedMessage {
+                .watch = watch,
+                .message = gst_message_ref(message) },
+            [] (gpointer userData) {
+                ForwardedMessage* forwarded = static_cast<ForwardedMessage*>(userData);
+                gst_message_unref(forwarded->message);
+                delete forwarded;
+            });
+
+        return G_SOURCE_CONTINUE;
+    };
+
+    GstBusPtr busPtr(gst_pipeline_get_bus(GST_PIPELINE(pipeline)));
+    GSource* source = gst_bus_create_watch(busPtr.get());
+    g_source_set_callback(
+        source,
+        GSourceFunc(onBusMessageCallback),
+        new std::shared_ptr<Watch>(watch),
+        [] (gpointer userData) {
+            delete static_cast<std::shared_ptr<Watch>*>(userData);
+        });
+    watch->source = source;
+
+    _watch = watch;
+
+    g_source_attach(source, context);
+}
+
+void BusWatch::remove() noexcept
+{
+    if(!_watch)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_watch->mutex);
+        _watch->removed = true;
+    }
+
+    g_source_destroy(_watch->source);
+    g_source_unref(_watch->source);
+    _watch->source = nullptr;
+
+    _watch.reset();
+}
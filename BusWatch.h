@@ -0,0 +1,37 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <gst/gst.h>
+
+
+// Pipeline bus watch dispatched on (worker) context.
+// Messages requiring control actions are forwarded to the main context.
+// Has to be added/removed from the main context.
+class BusWatch
+{
+public:
+    // called on watch context.
+    // returns true if message has to be forwarded to the main context also
+    typedef std::function<bool (GstMessage*)> WorkerHandler;
+    // called on the main context
+    typedef std::function<void (GstMessage*)> MainHandler;
+
+    ~BusWatch();
+
+    void add(
+        GstElement* pipeline,
+        GMainContext*, // nullptr - default main context
+        const WorkerHandler&,
+        const MainHandler&) noexcept;
+    // no handlers are called after return,
+    // including already forwarded messages
+    void remove() noexcept;
+
+private:
+    struct Watch;
+    struct ForwardedMessage;
+
+    std::shared_ptr<Watch> _watch;
+};
@@ -13,10 +13,25 @@ struct Config
 {
     static constexpr std::string_view KeyPlaceholder = "{key}";
 
+    struct QueueBudget;
     struct ReStreamer;
 
+    struct RestartPolicy {
+        unsigned firstDelay = 1000; // ms, delay of the first retry after failure
+        unsigned minDelay = 2000; // ms, the next retries delay grows exponentially from it
+        unsigned maxDelay = 60000; // ms
+        unsigned resetAfter = 60000; // ms of running to consider reStreamer stable
+        unsigned maxConcurrentStarts = 8; // inside start window, 0 - unlimited
+        unsigned startWindow = 2000; // ms
+        unsigned maxStartsInFlight = 8; // started, but not playing or failed yet, 0 - unlimited
+    };
+
     spdlog::level::level_enum logLevel = spdlog::level::info;
 
+    unsigned workerThreads = 2; // for pipelines bus handling, 0 - main thread only
+
+    RestartPolicy restartPolicy;
+
 #if VK_VIDEO_STREAMER
     std::string targetUrl = "rtmp://ovsu.okcdn.ru/input/{key}";
 #elif YOUTUBE_LIVE_STREAMER
@@ -27,12 +42,40 @@ struct Config
     std::deque<std::string> reStreamersOrder;
 };
 
+struct Config::QueueBudget {
+    enum class OverflowPolicy {
+        DropNew, // drop incoming data until queue drains and resume from keyframe
+        DropOld, // drop the oldest queued data
+    };
+
+    unsigned maxLatency = 2000; // ms, 0 - unlimited
+    unsigned maxBytes = 4 * 1024 * 1024; // 0 - unlimited
+    OverflowPolicy overflowPolicy = OverflowPolicy::DropNew;
+};
+
 struct Config::ReStreamer {
+    enum class Fallback {
+        None,
+        FrozenFrame, // the last keyframe from source
+        Slate, // fallbackImage
+    };
+
     std::string sourceUrl;
     std::string description;
-    std::string targetUrl;
+    std::deque<std::string> targetUrls;
     bool enabled;
     std::string forceH264ProfileLevelId = "42c015";
+    QueueBudget queueBudget;
+    unsigned stallTimeout = 3000; // ms without data from source to reconnect it, 0 - disabled
+    Fallback fallback = Fallback::None; // output while source is down
+    std::string fallbackImage;
+    int priority = 0; // reStreamers with higher priority are started first
+
+    // changes made over REST API are persisted to app config
+    bool dynamic = false; // added over REST API, so exists in app config only
+    bool modified = false; // changed over REST API, so app config values take precedence over user config
+    std::string originSourceUrl; // user config source and targets of modified reStreamer
+    std::deque<std::string> originTargetUrls;
 };
 
 struct ConfigChanges
@@ -43,5 +86,11 @@ struct ConfigChanges
 };
 
 struct ConfigChanges::ReStreamerChanges {
+    std::optional<Config::ReStreamer> added; // new reStreamer, other fields are ignored
+    bool removed = false;
+
     std::optional<bool> enabled;
+    std::optional<std::string> sourceUrl;
+    std::optional<std::string> description;
+    std::optional<std::deque<std::string>> targetUrls;
 };
@@ -0,0 +1,704 @@
+#include "ConfigLoader.h"
+
+#include <optional>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libconfig.h>
+
+#include "Log.h"
+#include "ConfigHelpers.h"
+#include "StreamerIndex.h"
+
+
+static const auto Log = ReStreamerLog;
+
+
+namespace {
+
+#if VK_VIDEO_STREAMER
+const char* ConfigFileName = "vk-streamer.conf";
+const char* AppConfigFileName = "vk-streamer.app.conf";
+#elif YOUTUBE_LIVE_STREAMER
+const char* ConfigFileName = "live-streamer.conf";
+const char* AppConfigFileName = "live-streamer.app.conf";
+#else
+const char* ConfigFileName = "rtmp-streamer.conf";
+const char* AppConfigFileName = "rtmp-streamer.app.conf";
+#endif
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(config_t, config_destroy)
+
+std::optional<std::string>
+AppConfigPath()
+{
+#ifdef SNAPCRAFT_BUILD
+    if(const gchar* snapData = g_getenv("SNAP_DATA")) {
+        std::string configFile = snapData;
+        configFile += "/";
+        configFile += AppConfigFileName;
+        return configFile;
+    }
+#endif
+
+    const std::deque<std::string> configDirs = ::ConfigDirs();
+    if(!configDirs.empty())
+        return *configDirs.rbegin() + "/" + AppConfigFileName;
+
+    return {};
+}
+
+void AddStringArray(
+    config_setting_t* group,
+    const char* name,
+    const std::deque<std::string>& strings)
+{
+    config_setting_t* array = config_setting_add(group, name, CONFIG_TYPE_ARRAY);
+    for(const std::string& string: strings) {
+        config_setting_t* element = config_setting_add(array, nullptr, CONFIG_TYPE_STRING);
+        config_setting_set_string(element, string.c_str());
+    }
+}
+
+// compares only what is saved to app config
+bool SameAppConfig(const Config& l, const Config& r)
+{
+    if(l.reStreamers.size() != r.reStreamers.size())
+        return false;
+
+    for(const auto& [uniqueId, lReStreamer]: l.reStreamers) {
+        const auto it = r.reStreamers.find(uniqueId);
+        if(it == r.reStreamers.end())
+            return false;
+
+        const Config::ReStreamer& rReStreamer = it->second;
+        if(lReStreamer.sourceUrl != rReStreamer.sourceUrl ||
+            lReStreamer.targetUrls != rReStreamer.targetUrls ||
+            lReStreamer.dynamic != rReStreamer.dynamic ||
+            lReStreamer.modified != rReStreamer.modified)
+        {
+            return false;
+        }
+
+        if(!lReStreamer.dynamic && !lReStreamer.modified)
+            continue;
+
+        if(lReStreamer.description != rReStreamer.description ||
+            lReStreamer.enabled != rReStreamer.enabled ||
+            lReStreamer.originSourceUrl != rReStreamer.originSourceUrl ||
+            lReStreamer.originTargetUrls != rReStreamer.originTargetUrls)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::string BuildTargetUrl(
+    const Config& config,
+    const char* targetUrl,
+    const char* key)
+{
+#if VK_VIDEO_STREAMER || YOUTUBE_LIVE_STREAMER
+    std::string outTargetUrl(targetUrl ? std::string_view(targetUrl) : config.targetUrl);
+#else
+    std::string outTargetUrl = targetUrl;
+#endif
+
+    std::string::size_type placeholderPos = outTargetUrl.find(
+        Config::KeyPlaceholder.data(),
+        Config::KeyPlaceholder.size());
+    if(placeholderPos == std::string::npos) {
+        return outTargetUrl;
+    } else if(key) {
+        return outTargetUrl.replace(
+            placeholderPos,
+            Config::KeyPlaceholder.size(),
+            key);
+    } else {
+        assert(false);
+        return std::string();
+    }
+}
+
+// modified reStreamers are matched by source and targets they had in user config,
+// and dynamic ones don't exist in user config at all
+StreamerIndex AppStreamerIndex(const Config& appConfig)
+{
+    StreamerIndex index;
+
+    for(const auto& [uniqueId, reStreamer]: appConfig.reStreamers) {
+        if(reStreamer.dynamic)
+            continue;
+
+        if(reStreamer.modified)
+            index.insert(reStreamer.originSourceUrl, reStreamer.originTargetUrls, uniqueId);
+        else
+            index.insert(reStreamer.sourceUrl, reStreamer.targetUrls, uniqueId);
+    }
+
+    return index;
+}
+
+// accepts both single string and list/array of strings
+void LoadStringList(
+    const config_setting_t* groupConfig,
+    const char* name,
+    std::deque<std::string>* out)
+{
+    config_setting_t* listConfig = config_setting_get_member(groupConfig, name);
+    if(!listConfig)
+        return;
+
+    if(CONFIG_TYPE_STRING == config_setting_type(listConfig)) {
+        if(const char* value = config_setting_get_string(listConfig))
+            out->push_back(value);
+        return;
+    }
+
+    if(CONFIG_FALSE == config_setting_is_aggregate(listConfig)) {
+        Log()->warn("Wrong \"{}\" property format. Property ignored.", name);
+        return;
+    }
+
+    const int count = config_setting_length(listConfig);
+    for(int idx = 0; idx < count; ++idx) {
+        const char* value = config_setting_get_string_elem(listConfig, idx);
+        if(!value || value[0] == '\0') {
+            Log()->warn("Wrong \"{}\" element format. Element skipped.", name);
+            continue;
+        }
+
+        out->push_back(value);
+    }
+}
+
+void LoadQueueBudget(
+    const config_setting_t* streamerConfig,
+    Config::QueueBudget* queueBudget)
+{
+    int maxLatency;
+    if(CONFIG_TRUE == config_setting_lookup_int(streamerConfig, "max-latency", &maxLatency)) {
+        if(maxLatency >= 0)
+            queueBudget->maxLatency = maxLatency;
+        else
+            Log()->warn("Wrong \"max-latency\" property value. Property ignored.");
+    }
+
+    int maxBytes;
+    if(CONFIG_TRUE == config_setting_lookup_int(streamerConfig, "max-bytes", &maxBytes)) {
+        if(maxBytes >= 0)
+            queueBudget->maxBytes = maxBytes;
+        else
+            Log()->warn("Wrong \"max-bytes\" property value. Property ignored.");
+    }
+
+    const char* overflow = nullptr;
+    if(CONFIG_TRUE == config_setting_lookup_string(streamerConfig, "overflow", &overflow)) {
+        if(0 == strcmp(overflow, "drop-new"))
+            queueBudget->overflowPolicy = Config::QueueBudget::OverflowPolicy::DropNew;
+        else if(0 == strcmp(overflow, "drop-old"))
+            queueBudget->overflowPolicy = Config::QueueBudget::OverflowPolicy::DropOld;
+        else
+            Log()->warn("Unknown \"overflow\" property value. Property ignored.");
+    }
+}
+
+void LoadFallback(
+    const config_setting_t* streamerConfig,
+    Config::ReStreamer* reStreamer)
+{
+    const char* fallbackImage = nullptr;
+    if(CONFIG_TRUE == config_setting_lookup_string(streamerConfig, "fallback-image", &fallbackImage)) {
+        reStreamer->fallbackImage = fallbackImage;
+        reStreamer->fallback = Config::ReStreamer::Fallback::Slate;
+    }
+
+    const char* fallback = nullptr;
+    if(CONFIG_TRUE == config_setting_lookup_string(streamerConfig, "fallback", &fallback)) {
+        if(0 == strcmp(fallback, "none"))
+            reStreamer->fallback = Config::ReStreamer::Fallback::None;
+        else if(0 == strcmp(fallback, "freeze"))
+            reStreamer->fallback = Config::ReStreamer::Fallback::FrozenFrame;
+        else if(0 == strcmp(fallback, "slate"))
+            reStreamer->fallback = Config::ReStreamer::Fallback::Slate;
+        else
+            Log()->warn("Unknown \"fallback\" property value. Property ignored.");
+    }
+
+    if(reStreamer->fallback == Config::ReStreamer::Fallback::Slate &&
+        reStreamer->fallbackImage.empty())
+    {
+        Log()->warn("\"fallback-image\" property is missing. Frozen frame will be used instead of slate.");
+        reStreamer->fallback = Config::ReStreamer::Fallback::FrozenFrame;
+    }
+}
+
+void LoadRestartPolicy(
+    const config_t& config,
+    Config::RestartPolicy* restartPolicy)
+{
+    config_setting_t* restartConfig = config_lookup(&config, "restart");
+    if(!restartConfig)
+        return;
+
+    if(CONFIG_FALSE == config_setting_is_group(restartConfig)) {
+        Log()->warn("Wrong \"restart\" property format. Property ignored.");
+        return;
+    }
+
+    auto lookupMs = [restartConfig] (const char* name, unsigned* value) {
+        int intValue;
+        if(CONFIG_TRUE == config_setting_lookup_int(restartConfig, name, &intValue)) {
+            if(intValue >= 0)
+                *value = intValue;
+            else
+                Log()->warn("Wrong \"{}\" property value. Property ignored.", name);
+        }
+    };
+
+    lookupMs("first-delay", &restartPolicy->firstDelay);
+    lookupMs("min-delay", &restartPolicy->minDelay);
+    lookupMs("max-delay", &restartPolicy->maxDelay);
+    lookupMs("reset-after", &restartPolicy->resetAfter);
+    lookupMs("max-concurrent-starts", &restartPolicy->maxConcurrentStarts);
+    lookupMs("start-window", &restartPolicy->startWindow);
+    lookupMs("max-starts-in-flight", &restartPolicy->maxStartsInFlight);
+
+    restartPolicy->maxDelay = std::max(restartPolicy->maxDelay, restartPolicy->minDelay);
+}
+
+void LoadStreamers(
+    const config_t& config,
+    Config* loadedConfig,
+    StreamerIndex* loadedIndex,
+    const Config* appConfig, // nullptr while app config itself is loading
+    const StreamerIndex* appIndex)
+{
+    const bool userConfigLoading = appConfig != nullptr;
+
+    config_setting_t* streamersConfig = config_lookup(&config, "streamers");
+    if(streamersConfig && CONFIG_TRUE == config_setting_is_list(streamersConfig)) {
+        const int streamersCount = config_setting_length(streamersConfig);
+        for(int streamerIdx = 0; streamerIdx < streamersCount; ++streamerIdx) {
+            config_setting_t* streamerConfig =
+                config_setting_get_elem(streamersConfig, streamerIdx);
+            if(!streamerConfig || CONFIG_FALSE == config_setting_is_group(streamerConfig)) {
+                Log()->warn("Wrong streamer config format. Streamer skipped.");
+                break;
+            }
+
+            const char* id = nullptr;
+            if(!userConfigLoading) {
+                config_setting_lookup_string(streamerConfig, "id", &id);
+            }
+            const char* source = nullptr;
+            config_setting_lookup_string(streamerConfig, "source", &source);
+            const char* target = nullptr;
+            config_setting_lookup_string(streamerConfig, "target", &target);
+            const char* description = "";
+            config_setting_lookup_string(streamerConfig, "description", &description);
+            const char* key = nullptr;
+#if YOUTUBE_LIVE_STREAMER
+            if(userConfigLoading) {
+                config_setting_lookup_string(streamerConfig, "youtube-stream-key", &key);
+            }
+#endif
+            config_setting_lookup_string(streamerConfig, "key", &key);
+            int enabled = TRUE;
+            config_setting_lookup_bool(streamerConfig, "enable", &enabled);
+
+            if(!source) {
+                Log()->warn("\"source\" property is empty. Streamer skipped.");
+                continue;
+            }
+
+            std::deque<std::string> keys;
+            if(key && key[0] != '\0')
+                keys.push_back(key);
+            LoadStringList(streamerConfig, "keys", &keys);
+
+            // complete target urls
+            std::deque<std::string> extraTargetUrls;
+            LoadStringList(streamerConfig, "targets", &extraTargetUrls);
+
+            std::deque<std::string> targetUrls;
+            if(const char* missing =
+                BuildTargetUrls(*loadedConfig, target, keys, extraTargetUrls, &targetUrls))
+            {
+                Log()->warn("\"{}\" property is missing. Streamer skipped.", missing);
+                continue;
+            }
+
+            int dynamic = FALSE;
+            int modified = FALSE;
+            std::string originSourceUrl;
+            std::deque<std::string> originTargetUrls;
+            if(!userConfigLoading) {
+                config_setting_lookup_bool(streamerConfig, "dynamic", &dynamic);
+                config_setting_lookup_bool(streamerConfig, "modified", &modified);
+                if(modified) {
+                    const char* originSource = nullptr;
+                    config_setting_lookup_string(streamerConfig, "origin-source", &originSource);
+                    LoadStringList(streamerConfig, "origin-targets", &originTargetUrls);
+                    if(!originSource || originTargetUrls.empty()) {
+                        Log()->warn("\"origin-source\" or \"origin-targets\" property is missing. Streamer skipped.");
+                        continue;
+                    }
+                    originSourceUrl = originSource;
+                }
+            }
+
+            if(appConfig) {
+                if(const std::string* appId = appIndex->find(source, targetUrls)) {
+                    id = appId->c_str(); // use id generated on some previous launch
+
+                    const Config::ReStreamer& appReStreamer = appConfig->reStreamers.at(*appId);
+                    if(appReStreamer.modified) {
+                        // changes made over REST API take precedence
+                        modified = TRUE;
+                        originSourceUrl = source;
+                        originTargetUrls = targetUrls;
+                        source = appReStreamer.sourceUrl.c_str();
+                        description = appReStreamer.description.c_str();
+                        targetUrls = appReStreamer.targetUrls;
+                        enabled = appReStreamer.enabled;
+                    }
+                }
+            }
+
+            if(loadedIndex->find(source, targetUrls)) {
+                Log()->warn("Found streamer with duplicated \"source\" and \"key\" properties. Streamer skipped.");
+                continue;
+            }
+
+            g_autofree gchar* uniqueId = nullptr;
+            if(!id) {
+                uniqueId = g_uuid_string_random();
+                id = uniqueId;
+            }
+
+            const auto& emplaceResult = loadedConfig->reStreamers.emplace(
+                id,
+                Config::ReStreamer {
+                    source,
+                    description,
+                    targetUrls,
+                    enabled != FALSE });
+            if(emplaceResult.second) {
+                Config::ReStreamer& loadedReStreamer = emplaceResult.first->second;
+                loadedReStreamer.dynamic = dynamic != FALSE;
+                loadedReStreamer.modified = modified != FALSE;
+                loadedReStreamer.originSourceUrl = originSourceUrl;
+                loadedReStreamer.originTargetUrls = originTargetUrls;
+                LoadQueueBudget(streamerConfig, &loadedReStreamer.queueBudget);
+                LoadFallback(streamerConfig, &loadedReStreamer);
+
+                config_setting_lookup_int(streamerConfig, "priority", &loadedReStreamer.priority);
+
+                int stallTimeout;
+                if(CONFIG_TRUE == config_setting_lookup_int(streamerConfig, "stall-timeout", &stallTimeout)) {
+                    if(stallTimeout >= 0)
+                        loadedReStreamer.stallTimeout = stallTimeout;
+                    else
+                        Log()->warn("Wrong \"stall-timeout\" property value. Property ignored.");
+                }
+                loadedConfig->reStreamersOrder.emplace_back(emplaceResult.first->first);
+                loadedIndex->insert(source, targetUrls, emplaceResult.first->first);
+            }
+        }
+    }
+}
+
+}
+
+const char* BuildTargetUrls(
+    const Config& config,
+    const char* target,
+    const std::deque<std::string>& keys,
+    const std::deque<std::string>& extraTargetUrls,
+    std::deque<std::string>* outTargetUrls)
+{
+    std::deque<std::string> targetUrls;
+
+    bool needsKey = true;
+    if(target) {
+        std::string_view targetView = target;
+        needsKey = targetView.find(
+            Config::KeyPlaceholder.data(),
+            Config::KeyPlaceholder.size()) != std::string_view::npos;
+        if(!needsKey)
+            targetUrls.push_back(target);
+#if VK_VIDEO_STREAMER || YOUTUBE_LIVE_STREAMER
+    } else if(config.targetUrl.empty()) {
+#else
+    } else {
+#endif
+        if(extraTargetUrls.empty())
+            return "target";
+        needsKey = false;
+    }
+
+    if(needsKey) {
+        if(keys.empty() && extraTargetUrls.empty())
+            return "key";
+
+        for(const std::string& streamKey: keys)
+            targetUrls.push_back(BuildTargetUrl(config, target, streamKey.c_str()));
+    }
+
+    targetUrls.insert(targetUrls.end(), extraTargetUrls.begin(), extraTargetUrls.end());
+
+    for(auto it = targetUrls.begin(); it != targetUrls.end();) {
+        if(std::find(targetUrls.begin(), it, *it) != it) {
+            Log()->warn("Found duplicated target. Target skipped.");
+            it = targetUrls.erase(it);
+        } else
+            ++it;
+    }
+
+    *outTargetUrls = std::move(targetUrls);
+
+    return nullptr;
+}
+
+std::string UserConfigPath(const std::string& userConfigDir)
+{
+    return userConfigDir + "/" + ConfigFileName;
+}
+
+// called from ConfigWriter thread
+void SaveAppConfig(const Config& appConfig)
+{
+    const std::optional<std::string>& targetPath = AppConfigPath();
+    if(!targetPath) return;
+
+    const auto& reStreamers = appConfig.reStreamers;
+
+    Log()->info("Writing config to \"{}\"", *targetPath);
+
+    g_auto(config_t) config;
+    config_init(&config);
+
+    config_setting_t* root = config_root_setting(&config);
+    config_setting_t* streamers = config_setting_add(root, "streamers", CONFIG_TYPE_LIST);
+
+    for(const std::string& uniqueId: appConfig.reStreamersOrder) {
+        const auto it = reStreamers.find(uniqueId);
+        if(it == reStreamers.end()) continue;
+
+        config_setting_t* streamer = config_setting_add(streamers, nullptr, CONFIG_TYPE_GROUP);
+
+        config_setting_t* id = config_setting_add(streamer, "id", CONFIG_TYPE_STRING);
+        config_setting_set_string(id, it->first.c_str());
+
+        config_setting_t* source = config_setting_add(streamer, "source", CONFIG_TYPE_STRING);
+        config_setting_set_string(source, it->second.sourceUrl.c_str());
+
+        AddStringArray(streamer, "targets", it->second.targetUrls);
+
+        if(!it->second.dynamic && !it->second.modified)
+            continue;
+
+        config_setting_t* description = config_setting_add(streamer, "description", CONFIG_TYPE_STRING);
+        config_setting_set_string(description, it->second.description.c_str());
+
+        config_setting_t* enable = config_setting_add(streamer, "enable", CONFIG_TYPE_BOOL);
+        config_setting_set_bool(enable, it->second.enabled);
+
+        if(it->second.dynamic) {
+            config_setting_t* dynamic = config_setting_add(streamer, "dynamic", CONFIG_TYPE_BOOL);
+            config_setting_set_bool(dynamic, TRUE);
+        } else {
+            config_setting_t* modified = config_setting_add(streamer, "modified", CONFIG_TYPE_BOOL);
+            config_setting_set_bool(modified, TRUE);
+
+            config_setting_t* originSource = config_setting_add(streamer, "origin-source", CONFIG_TYPE_STRING);
+            config_setting_set_string(originSource, it->second.originSourceUrl.c_str());
+
+            AddStringArray(streamer, "origin-targets", it->second.originTargetUrls);
+        }
+    }
+
+    // written to temporary file and renamed over the old one,
+    // so crash in the middle of write doesn't leave broken config
+    const std::string tmpPath = *targetPath + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "w");
+    if(!file) {
+        Log()->error("Fail save config. Can't open \"{}\"", tmpPath);
+        return;
+    }
+
+    config_write(&config, file);
+    const bool written =
+        fflush(file) == 0 &&
+        fsync(fileno(file)) == 0;
+    fclose(file);
+
+    if(!written || g_rename(tmpPath.c_str(), targetPath->c_str()) != 0) {
+        Log()->error("Fail save config \"{}\"", *targetPath);
+        g_unlink(tmpPath.c_str());
+    }
+}
+
+bool LoadConfig(
+    http::Config* httpConfig,
+    signalling::Config* wsConfig,
+    Config* config,
+    bool* appConfigOutdated)
+{
+    const std::deque<std::string> configDirs = ::ConfigDirs();
+    if(configDirs.empty())
+        return false;
+
+    http::Config loadedHttpConfig = *httpConfig;
+    signalling::Config loadedWsConfig = *wsConfig;
+    Config loadedConfig = *config;
+    StreamerIndex loadedIndex(loadedConfig);
+    Config loadedAppConfig;
+    StreamerIndex appIndex;
+
+    if(const auto& appConfigPath = AppConfigPath()) {
+        if(g_file_test(appConfigPath->c_str(), G_FILE_TEST_IS_REGULAR)) {
+            g_auto(config_t) config;
+            config_init(&config);
+
+            Log()->info("Loading config \"{}\"", *appConfigPath);
+            if(!config_read_file(&config, appConfigPath->c_str())) {
+                Log()->error("Fail load config. {}. {}:{}",
+                    config_error_text(&config),
+                    *appConfigPath,
+                    config_error_line(&config));
+                return false;
+            }
+
+            StreamerIndex loadedAppIndex;
+            LoadStreamers(config, &loadedAppConfig, &loadedAppIndex, nullptr, nullptr);
+            appIndex = AppStreamerIndex(loadedAppConfig);
+        }
+    }
+
+    for(const std::string& configDir: configDirs) {
+        const std::string& configFile = UserConfigPath(configDir);
+        if(!g_file_test(configFile.c_str(),  G_FILE_TEST_IS_REGULAR)) {
+            Log()->info("Config \"{}\" not found", configFile);
+            continue;
+        }
+
+        g_auto(config_t) config;
+        config_init(&config);
+
+        Log()->info("Loading config \"{}\"", configFile);
+        if(!config_read_file(&config, configFile.c_str())) {
+            Log()->error("Fail load config. {}. {}:{}",
+                config_error_text(&config),
+                configFile,
+                config_error_line(&config));
+            return false;
+        }
+
+        int logLevel = 0;
+        if(CONFIG_TRUE == config_lookup_int(&config, "log-level", &logLevel)) {
+            if(logLevel > 0) {
+                loadedConfig.logLevel =
+                    static_cast<spdlog::level::level_enum>(
+                        spdlog::level::critical - std::min<int>(logLevel, spdlog::level::critical));
+            }
+        }
+
+        int workerThreads = 0;
+        if(CONFIG_TRUE == config_lookup_int(&config, "worker-threads", &workerThreads)) {
+            if(workerThreads >= 0)
+                loadedConfig.workerThreads = workerThreads;
+            else
+                Log()->warn("Wrong \"worker-threads\" property value. Property ignored.");
+        }
+
+        LoadRestartPolicy(config, &loadedConfig.restartPolicy);
+
+        const char* wwwRoot = nullptr;
+        if(CONFIG_TRUE == config_lookup_string(&config, "www-root", &wwwRoot)) {
+            loadedHttpConfig.wwwRoot = wwwRoot;
+        }
+
+        int loopbackOnly = false;
+        if(CONFIG_TRUE == config_lookup_bool(&config, "loopback-only", &loopbackOnly)) {
+            loadedHttpConfig.bindToLoopbackOnly = loopbackOnly != false;
+        }
+
+        int httpPort;
+        if(CONFIG_TRUE == config_lookup_int(&config, "http-port", &httpPort)) {
+            loadedHttpConfig.port = static_cast<unsigned short>(httpPort);
+        }
+
+        int wsPort;
+        if(CONFIG_TRUE == config_lookup_int(&config, "ws-port", &wsPort)) {
+            loadedWsConfig.port = static_cast<unsigned short>(wsPort);
+        }
+
+        const char* source = nullptr;
+        config_lookup_string(&config, "source", &source);
+        const char* key = nullptr;
+        config_lookup_string(&config, "key", &key);
+
+        if(source && key) {
+            const std::deque<std::string> targetUrls = { BuildTargetUrl(loadedConfig, nullptr, key) };
+            if(!loadedIndex.find(source, targetUrls)) {
+                g_autofree gchar* uniqueId = g_uuid_string_random();
+                const auto& emplaceResult = loadedConfig.reStreamers.emplace(
+                    uniqueId,
+                    Config::ReStreamer {
+                        source,
+                        std::string(),
+                        targetUrls,
+                        true });
+                if(emplaceResult.second) {
+                    loadedConfig.reStreamersOrder.emplace_back(emplaceResult.first->first);
+                    loadedIndex.insert(source, targetUrls, emplaceResult.first->first);
+                }
+            }
+        }
+
+        LoadStreamers(config, &loadedConfig, &loadedIndex, &loadedAppConfig, &appIndex);
+    }
+
+    for(const std::string& uniqueId: loadedAppConfig.reStreamersOrder) {
+        const Config::ReStreamer& appReStreamer = loadedAppConfig.reStreamers.at(uniqueId);
+        if(!appReStreamer.dynamic)
+            continue;
+
+        if(loadedIndex.find(appReStreamer.sourceUrl, appReStreamer.targetUrls)) {
+            Log()->warn("Found streamer with duplicated \"source\" and \"key\" properties. Streamer skipped.");
+            continue;
+        }
+
+        const auto& emplaceResult = loadedConfig.reStreamers.emplace(uniqueId, appReStreamer);
+        if(emplaceResult.second) {
+            loadedConfig.reStreamersOrder.emplace_back(uniqueId);
+            loadedIndex.insert(appReStreamer.sourceUrl, appReStreamer.targetUrls, uniqueId);
+        }
+    }
+
+    bool success = true;
+    if(loadedConfig.reStreamers.empty()) {
+        Log()->warn("No streamers configured");
+    }
+
+    if(success) {
+        *appConfigOutdated = !SameAppConfig(loadedAppConfig, loadedConfig);
+
+        *httpConfig = loadedHttpConfig;
+        *config = std::move(loadedConfig);
+    }
+
+    assert(config->reStreamers.size() == config->reStreamersOrder.size());
+
+    return success;
+}
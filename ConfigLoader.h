@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <deque>
+
+#include "WebRTSP/Http/Config.h"
+#include "WebRTSP/Signalling/Config.h"
+
+#include "Config.h"
+
+
+std::string UserConfigPath(const std::string& userConfigDir);
+
+// completes reStreamer target urls the same way for config files and REST API:
+// "target" (or default target if there is no one) with "{key}" placeholder
+// is expanded with every key, "targets" are taken as is, duplicates are skipped.
+// returns name of missing property on failure
+const char* BuildTargetUrls(
+    const Config&,
+    const char* target, // nullable
+    const std::deque<std::string>& keys,
+    const std::deque<std::string>& targets,
+    std::deque<std::string>* outTargetUrls);
+
+// loads user configs from all ConfigDirs() over passed values,
+// reStreamers ids and changes made over REST API are taken from app config
+bool LoadConfig(
+    http::Config*,
+    signalling::Config*,
+    Config*,
+    bool* appConfigOutdated); // reStreamers differ from saved to app config
+
+// saves reStreamers ids and changes made over REST API to app config,
+// can be called from any thread
+void SaveAppConfig(const Config&);
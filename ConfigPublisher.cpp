@@ -0,0 +1,21 @@
+#include "ConfigPublisher.h"
+
+
+ConfigPublisher::ConfigPublisher(const Config& config) :
+    _snapshot(std::make_shared<const ConfigSnapshot>(ConfigSnapshot { ++_version, config, StreamerIndex(config) }))
+{
+}
+
+void ConfigPublisher::publish(const Config& config) noexcept
+{
+    std::shared_ptr<const ConfigSnapshot> snapshot =
+        std::make_shared<const ConfigSnapshot>(ConfigSnapshot { ++_version, config, StreamerIndex(config) });
+
+    // previous snapshot is freed by the last reader releasing it
+    std::atomic_store(&_snapshot, std::move(snapshot));
+}
+
+std::shared_ptr<const ConfigSnapshot> ConfigPublisher::snapshot() const noexcept
+{
+    return std::atomic_load(&_snapshot);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+
+#include <glib.h>
+
+#include "Config.h"
+#include "StreamerIndex.h"
+
+
+// immutable Config state, never changed after publishing
+struct ConfigSnapshot
+{
+    guint64 version; // grows with every published snapshot
+    Config config;
+    StreamerIndex index; // of config reStreamers
+};
+
+// Publishes Config snapshots from the main loop (the only writer)
+// to be read from any thread (RCU style):
+// readers keep the snapshot they got alive while they use it,
+// and writer replaces the whole snapshot with std::atomic_store.
+// Note std::atomic_load/store on shared_ptr are not lock-free in libstdc++
+// (they take a mutex from a small global pool for a few instructions),
+// but readers never wait for config copying or main loop work.
+class ConfigPublisher
+{
+public:
+    explicit ConfigPublisher(const Config&);
+
+    // has to be called from the main loop only
+    void publish(const Config&) noexcept;
+
+    // thread safe
+    std::shared_ptr<const ConfigSnapshot> snapshot() const noexcept;
+
+private:
+    guint64 _version = 0; // accessed from the main loop only
+    std::shared_ptr<const ConfigSnapshot> _snapshot; // accessed with std::atomic_load/store only
+};
@@ -0,0 +1,70 @@
+#include "ConfigWriter.h"
+
+#include <algorithm>
+
+
+ConfigWriter::ConfigWriter(
+    const Write& write,
+    unsigned delay,
+    unsigned maxDelay) :
+    _write(write), _delay(delay), _maxDelay(std::max(delay, maxDelay)),
+    _thread(&ConfigWriter::run, this)
+{
+}
+
+ConfigWriter::~ConfigWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _condition.notify_one();
+
+    _thread.join();
+}
+
+void ConfigWriter::schedule(const std::shared_ptr<const ConfigSnapshot>& snapshot) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        const auto now = std::chrono::steady_clock::now();
+        if(!_pending)
+            _firstScheduled = now;
+        _lastScheduled = now;
+
+        _pending = snapshot;
+    }
+    _condition.notify_one();
+}
+
+void ConfigWriter::run() noexcept
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for(;;) {
+        _condition.wait(lock, [this] () { return _pending || _stopping; });
+
+        // wait for changes to settle down
+        while(!_stopping) {
+            const auto deadline =
+                std::min(_lastScheduled + _delay, _firstScheduled + _maxDelay);
+            if(std::chrono::steady_clock::now() >= deadline)
+                break;
+
+            _condition.wait_until(lock, deadline);
+        }
+
+        if(_pending) {
+            std::shared_ptr<const ConfigSnapshot> snapshot = std::move(_pending);
+            _pending.reset();
+
+            lock.unlock();
+            _write(snapshot->config);
+            lock.lock();
+        }
+
+        if(_stopping && !_pending)
+            return;
+    }
+}
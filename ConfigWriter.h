@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "ConfigPublisher.h"
+
+
+// Saves config snapshots on own thread to not block the main loop.
+// Snapshots scheduled in a row are coalesced,
+// so burst of changes results in a single write of the latest one.
+class ConfigWriter
+{
+public:
+    typedef std::function<void (const Config&)> Write;
+
+    ConfigWriter(
+        const Write&,
+        unsigned delay, // ms of quiet after the last change to write
+        unsigned maxDelay); // ms, limits delay of continuously changing config
+    ~ConfigWriter(); // writes pending snapshot if any
+
+    // thread safe
+    void schedule(const std::shared_ptr<const ConfigSnapshot>&) noexcept;
+
+private:
+    void run() noexcept;
+
+private:
+    const Write _write;
+    const std::chrono::milliseconds _delay;
+    const std::chrono::milliseconds _maxDelay;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _stopping = false;
+    std::shared_ptr<const ConfigSnapshot> _pending;
+    std::chrono::steady_clock::time_point _firstScheduled;
+    std::chrono::steady_clock::time_point _lastScheduled;
+
+    std::thread _thread; // has to be initialized last
+};
@@ -0,0 +1,699 @@
+#include "Ingest.h"
+
+#include <cassert>
+#include <deque>
+
+#include <time.h>
+
+#include <CxxPtr/GlibPtr.h>
+
+#include "Log.h"
+#include "LatencyTracker.h"
+
+
+static const auto Log = ReStreamerLog;
+
+
+namespace {
+
+const char* const VideoSinkCaps = "video/x-h264, stream-format=avc, alignment=au";
+const char* const AacCaps = "audio/mpeg, mpegversion=(int){2, 4}";
+const char* const Mp3Caps = "audio/mpeg, mpegversion=(int)1";
+// the subset of compressed audio formats flvmux accepts
+const char* const FlvCompressedAudioCaps =
+    "audio/mpeg, mpegversion=(int){2, 4}; "
+    "audio/mpeg, mpegversion=(int)1, rate=(int){5512, 8000, 11025, 22050, 44100}";
+const char* const AudioSinkCaps =
+    "audio/mpeg, mpegversion=(int){2, 4}, stream-format=raw; "
+    "audio/mpeg, mpegversion=(int)1, layer=(int)3";
+
+GstStaticCaps ArrivalTimeCaps = GST_STATIC_CAPS("timestamp/x-ingest-arrival");
+
+const char* const VideoQueueName = "video-queue";
+const char* const AudioQueueName = "audio-queue";
+const GstClockTime IngestQueueMaxTime = 1 * GST_SECOND;
+
+GstElement* MakeAacEncoder()
+{
+    for(const char* encoderName: { "fdkaacenc", "avenc_aac", "voaacenc", "faac" }) {
+        if(GstElement* encoder = gst_element_factory_make(encoderName, nullptr))
+            return encoder;
+    }
+
+    return nullptr;
+}
+
+GstClockTime ThreadCpuTime()
+{
+    timespec time;
+    if(0 != clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time))
+        return 0;
+
+    return GST_TIMESPEC_TO_TIME(time);
+}
+
+const char* AudioModeName(Ingest::AudioMode mode)
+{
+    switch(mode) {
+        case Ingest::AudioMode::None:
+            return "none";
+        case Ingest::AudioMode::Passthrough:
+            return "passthrough";
+        case Ingest::AudioMode::Transcode:
+            return "transcode";
+        case Ingest::AudioMode::Silence:
+            return "silence";
+    }
+
+    return "unknown";
+}
+
+}
+
+
+Ingest::Ingest(
+    const std::string& sourceUrl,
+    GMainContext* busContext,
+    const std::function<void ()>& onPlaying,
+    const std::function<void ()>& onEos) :
+    _onPlaying(onPlaying), _onEos(onEos), _sourceUrl(sourceUrl), _busContext(busContext)
+{
+}
+
+Ingest::~Ingest()
+{
+    assert(!hasConsumers());
+
+    stop();
+}
+
+void Ingest::attach(Consumer* consumer) noexcept
+{
+    std::lock_guard<std::mutex> lock(_consumersMutex);
+    _consumers.insert(consumer);
+}
+
+void Ingest::detach(Consumer* consumer) noexcept
+{
+    // after return no more samples will be delivered to consumer
+    std::lock_guard<std::mutex> lock(_consumersMutex);
+    _consumers.erase(consumer);
+}
+
+bool Ingest::hasConsumers() const noexcept
+{
+    std::lock_guard<std::mutex> lock(_consumersMutex);
+    return !_consumers.empty();
+}
+
+GstSample* Ingest::RebaseSample(
+    GstSample* sample,
+    GstClockTime sourceBaseTime,
+    GstClockTime targetBaseTime) noexcept
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    const GstSegment* segment = gst_sample_get_segment(sample);
+    if(!buffer || !segment)
+        return nullptr;
+
+    auto rebase = [&] (GstClockTime timestamp) -> GstClockTime {
+        if(!GST_CLOCK_TIME_IS_VALID(timestamp))
+            return GST_CLOCK_TIME_NONE;
+
+        const GstClockTime runningTime =
+            gst_segment_to_running_time(segment, GST_FORMAT_TIME, timestamp);
+        if(!GST_CLOCK_TIME_IS_VALID(runningTime))
+            return GST_CLOCK_TIME_NONE;
+
+        const GstClockTime clockTime = runningTime + sourceBaseTime;
+        if(clockTime < targetBaseTime)
+            return GST_CLOCK_TIME_NONE;
+
+        return clockTime - targetBaseTime;
+    };
+
+    const GstClockTime pts = rebase(GST_BUFFER_PTS(buffer));
+    const GstClockTime dts = rebase(GST_BUFFER_DTS(buffer));
+    if(!GST_CLOCK_TIME_IS_VALID(pts) && !GST_CLOCK_TIME_IS_VALID(dts))
+        return nullptr;
+
+    // only metadata is copied, memory is shared with original buffer
+    GstBuffer* outBuffer = gst_buffer_copy(buffer);
+    GST_BUFFER_PTS(outBuffer) = pts;
+    GST_BUFFER_DTS(outBuffer) = dts;
+
+    GstSample* outSample =
+        gst_sample_new(outBuffer, gst_sample_get_caps(sample), nullptr, nullptr);
+    gst_buffer_unref(outBuffer);
+
+    return outSample;
+}
+
+GstClockTime Ingest::SampleClockTime(GstSample* sample, GstClockTime baseTime) noexcept
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    const GstSegment* segment = gst_sample_get_segment(sample);
+    if(!buffer || !segment)
+        return GST_CLOCK_TIME_NONE;
+
+    const GstClockTime timestamp =
+        GST_BUFFER_DTS_IS_VALID(buffer) ? GST_BUFFER_DTS(buffer) : GST_BUFFER_PTS(buffer);
+    if(!GST_CLOCK_TIME_IS_VALID(timestamp))
+        return GST_CLOCK_TIME_NONE;
+
+    const GstClockTime runningTime =
+        gst_segment_to_running_time(segment, GST_FORMAT_TIME, timestamp);
+    if(!GST_CLOCK_TIME_IS_VALID(runningTime))
+        return GST_CLOCK_TIME_NONE;
+
+    return runningTime + baseTime;
+}
+
+GstClockTime Ingest::ArrivalTime(GstBuffer* buffer) noexcept
+{
+    GstReferenceTimestampMeta* meta =
+        gst_buffer_get_reference_timestamp_meta(buffer, gst_static_caps_get(&ArrivalTimeCaps));
+    return meta ? meta->timestamp : GST_CLOCK_TIME_NONE;
+}
+
+void Ingest::SetArrivalTime(GstBuffer* buffer, GstClockTime arrivalTime) noexcept
+{
+    gst_buffer_add_reference_timestamp_meta(
+        buffer,
+        gst_static_caps_get(&ArrivalTimeCaps),
+        arrivalTime,
+        GST_CLOCK_TIME_NONE);
+}
+
+void Ingest::stop() noexcept
+{
+    _busWatch.remove();
+
+    if(_pipelinePtr) {
+        gst_element_set_state(_pipelinePtr.get(), GST_STATE_NULL);
+        _pipelinePtr.reset();
+
+        const Stats stats = this->stats();
+        if(stats.audioMode != AudioMode::None) {
+            Log()->info(
+                "Source \"{}\" audio {}: {} buffers, {} ms of CPU time",
+                _sourceUrl,
+                AudioModeName(stats.audioMode),
+                stats.audioBuffers,
+                stats.audioProcessingTime / GST_MSECOND);
+        }
+    }
+
+    _videoLinked = false;
+    _audioLinked = false;
+    _audioMode = AudioMode::None;
+    _audioBuffers = 0;
+    _audioProcessingTime = 0;
+    _audioBranchEntryTime = GST_CLOCK_TIME_NONE;
+    _silence.reset();
+}
+
+// called on bus worker context
+bool Ingest::onWorkerBusMessage(GstMessage* message)
+{
+    switch(GST_MESSAGE_TYPE(message)) {
+        case GST_MESSAGE_STATE_CHANGED: {
+            if(GST_MESSAGE_SRC(message) != GST_OBJECT(_pipelinePtr.get()))
+                return false;
+
+            GstState newState;
+            gst_message_parse_state_changed(message, nullptr, &newState, nullptr);
+            return newState == GST_STATE_PLAYING;
+        }
+        case GST_MESSAGE_EOS:
+            return true;
+        case GST_MESSAGE_ERROR: {
+            g_autofree gchar* debug = nullptr;
+            g_autoptr(GError) error = nullptr;
+            gst_message_parse_error(message, &error, &debug);
+
+            unsigned suppressed;
+            if(_errorLogLimiter.allow(&suppressed)) {
+                if(suppressed)
+                    Log()->warn("{} errors from source \"{}\" were suppressed", suppressed, _sourceUrl);
+
+                Log()->error("Got error from source \"{}\" pipeline: {}", _sourceUrl, error->message);
+                if(debug)
+                    Log()->debug("{}", debug);
+            }
+
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+void Ingest::onBusMessage(GstMessage* message)
+{
+    switch(GST_MESSAGE_TYPE(message)) {
+        case GST_MESSAGE_STATE_CHANGED:
+            // only pipeline PLAYING state is forwarded from worker
+            _onPlaying();
+            break;
+        case GST_MESSAGE_EOS:
+            onEos(false);
+            break;
+        case GST_MESSAGE_ERROR:
+            onEos(true);
+            break;
+        default:
+            break;
+    }
+}
+
+void Ingest::onEos(bool /*error*/)
+{
+    stop();
+
+    // restart is scheduled by owner
+    _onEos();
+}
+
+void Ingest::reconnect(gint64 stalledSince) noexcept
+{
+    if(!_pipelinePtr || _startTime > stalledSince)
+        return;
+
+    Log()->info("Reconnecting to source \"{}\"...", _sourceUrl);
+
+    onEos(true);
+}
+
+void Ingest::start() noexcept
+{
+    stop();
+
+    _startTime = g_get_monotonic_time();
+
+    GstElementPtr pipelinePtr(gst_pipeline_new(nullptr));
+    GstElement* pipeline = pipelinePtr.get();
+    if(!pipeline) {
+        Log()->error("Failed to create pipeline element");
+        return;
+    }
+
+    // all pipelines fed by ingest should share clock with it
+    // to be able to move timestamps between pipelines
+    g_autoptr(GstClock) clock = gst_system_clock_obtain();
+    gst_pipeline_use_clock(GST_PIPELINE(pipeline), clock);
+
+    GstElementPtr srcPtr(gst_element_factory_make("uridecodebin", nullptr));
+    GstElement* decodebin = srcPtr.get();
+    if(!decodebin) {
+        Log()->error("Failed to create \"uridecodebin\" element");
+        return;
+    }
+
+    _h264CapsPtr.reset(gst_caps_from_string("video/x-h264"));
+    _aacCapsPtr.reset(gst_caps_from_string(AacCaps));
+    _mp3CapsPtr.reset(gst_caps_from_string(Mp3Caps));
+    _flvCompressedAudioCapsPtr.reset(gst_caps_from_string(FlvCompressedAudioCaps));
+    _audioRawCapsPtr.reset(gst_caps_from_string("audio/x-raw"));
+
+    // compressed audio is not decoded if FLV is able to carry it
+    GstCapsPtr supportedCapsPtr(gst_caps_copy(_h264CapsPtr.get()));
+    gst_caps_append(supportedCapsPtr.get(), gst_caps_copy(_aacCapsPtr.get()));
+    gst_caps_append(supportedCapsPtr.get(), gst_caps_copy(_mp3CapsPtr.get()));
+    gst_caps_append(supportedCapsPtr.get(), gst_caps_copy(_audioRawCapsPtr.get()));
+    GstCaps* supportedCaps = supportedCapsPtr.get();
+
+    g_object_set(decodebin, "caps", supportedCaps, nullptr);
+
+    auto srcPadAddedCallback =
+        (void (*)(GstElement*, GstPad*, gpointer))
+         [] (GstElement* decodebin, GstPad* pad, gpointer userData)
+    {
+        Ingest* self = static_cast<Ingest*>(userData);
+        self->srcPadAdded(decodebin, pad);
+    };
+    g_signal_connect(decodebin, "pad-added", G_CALLBACK(srcPadAddedCallback), this);
+
+    auto noMorePadsCallback =
+        (void (*)(GstElement*,  gpointer))
+         [] (GstElement* decodebin, gpointer userData)
+    {
+        Ingest* self = static_cast<Ingest*>(userData);
+        self->noMorePads(decodebin);
+    };
+    g_signal_connect(decodebin, "no-more-pads", G_CALLBACK(noMorePadsCallback), this);
+
+    g_object_set(decodebin,
+        "uri", _sourceUrl.c_str(),
+        nullptr);
+
+    gst_bin_add(GST_BIN(pipeline), srcPtr.release());
+
+    _pipelinePtr = std::move(pipelinePtr);
+
+    _busWatch.add(
+        pipeline,
+        _busContext,
+        [this] (GstMessage* message) { return onWorkerBusMessage(message); },
+        [this] (GstMessage* message) { onBusMessage(message); });
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+}
+
+// returns entry element of the sink
+GstElement* Ingest::addAppSink(Stream stream, const char* caps)
+{
+    GstElement* pipeline = _pipelinePtr.get();
+
+    // consumers are fed from own streaming thread of the queue,
+    // so demuxer is not stalled by slow consumer
+    GstElementPtr queuePtr(
+        gst_element_factory_make(
+            "queue",
+            stream == Stream::Video ? VideoQueueName : AudioQueueName));
+    GstElement* queue = queuePtr.get();
+    if(!queue) {
+        Log()->error("Failed to create \"queue\" element");
+        return nullptr;
+    }
+
+    g_object_set(queue,
+        "max-size-buffers", 0,
+        "max-size-bytes", 0,
+        "max-size-time", static_cast<guint64>(IngestQueueMaxTime),
+        nullptr);
+
+    GstElementPtr appSinkPtr(gst_element_factory_make("appsink", nullptr));
+    GstElement* appSink = appSinkPtr.get();
+    if(!appSink) {
+        Log()->error("Failed to create \"appsink\" element");
+        return nullptr;
+    }
+
+    GstCapsPtr capsPtr(gst_caps_from_string(caps));
+    g_object_set(appSink,
+        "caps", capsPtr.get(),
+        "sync", FALSE,
+        nullptr);
+
+    auto newVideoSampleCallback =
+        (GstFlowReturn (*)(GstAppSink*, gpointer))
+        [] (GstAppSink* appSink, gpointer userData) -> GstFlowReturn
+    {
+        Ingest* self = static_cast<Ingest*>(userData);
+        return self->onNewSample(Stream::Video, appSink);
+    };
+    auto newAudioSampleCallback =
+        (GstFlowReturn (*)(GstAppSink*, gpointer))
+        [] (GstAppSink* appSink, gpointer userData) -> GstFlowReturn
+    {
+        Ingest* self = static_cast<Ingest*>(userData);
+        return self->onNewSample(Stream::Audio, appSink);
+    };
+
+    GstAppSinkCallbacks callbacks {};
+    callbacks.new_sample =
+        stream == Stream::Video ? newVideoSampleCallback : newAudioSampleCallback;
+    gst_app_sink_set_callbacks(GST_APP_SINK(appSink), &callbacks, this, nullptr);
+
+    gst_bin_add_many(GST_BIN(pipeline), queuePtr.release(), appSinkPtr.release(), nullptr);
+    gst_element_link(queue, appSink);
+    gst_element_sync_state_with_parent(appSink);
+    gst_element_sync_state_with_parent(queue);
+
+    return queue;
+}
+
+bool Ingest::linkAudio(GstPad* pad, AudioMode mode)
+{
+    GstElement* pipeline = _pipelinePtr.get();
+
+    std::deque<GstElementPtr> elementPtrs;
+    switch(mode) {
+        case AudioMode::Passthrough: {
+            GstCapsPtr capsPtr(gst_pad_get_current_caps(pad));
+            if(gst_caps_can_intersect(capsPtr.get(), _aacCapsPtr.get()))
+                elementPtrs.emplace_back(gst_element_factory_make("aacparse", nullptr));
+            else
+                elementPtrs.emplace_back(gst_element_factory_make("mpegaudioparse", nullptr));
+            break;
+        }
+        case AudioMode::Transcode:
+            elementPtrs.emplace_back(gst_element_factory_make("audioconvert", nullptr));
+            elementPtrs.emplace_back(gst_element_factory_make("audioresample", nullptr));
+            elementPtrs.emplace_back(MakeAacEncoder());
+            elementPtrs.emplace_back(gst_element_factory_make("aacparse", nullptr));
+            break;
+        case AudioMode::None:
+        case AudioMode::Silence:
+            assert(false);
+            return false;
+    }
+
+    for(const GstElementPtr& elementPtr: elementPtrs) {
+        if(!elementPtr) {
+            Log()->error("Failed to create audio processing element");
+            return false;
+        }
+    }
+
+    GstElement* sink = addAppSink(Stream::Audio, AudioSinkCaps);
+    if(!sink)
+        return false;
+
+    std::deque<GstElement*> elements;
+    for(GstElementPtr& elementPtr: elementPtrs) {
+        GstElement* element = elementPtr.release();
+        gst_bin_add(GST_BIN(pipeline), element);
+
+        if(!elements.empty())
+            gst_element_link(elements.back(), element);
+        elements.push_back(element);
+    }
+    gst_element_link(elements.back(), sink);
+
+    for(auto it = elements.rbegin(); it != elements.rend(); ++it)
+        gst_element_sync_state_with_parent(*it);
+
+    _audioMode = mode;
+
+    // all elements work in the same streaming thread,
+    // so CPU time spent by thread between branch entry and sink queue
+    // is the cost of audio processing
+    auto branchEntryCallback =
+        (GstPadProbeReturn (*)(GstPad*, GstPadProbeInfo*, gpointer))
+        [] (GstPad*, GstPadProbeInfo*, gpointer userData) -> GstPadProbeReturn
+    {
+        Ingest* self = static_cast<Ingest*>(userData);
+        self->_audioBranchEntryTime = ThreadCpuTime();
+        return GST_PAD_PROBE_OK;
+    };
+    GstPadPtr entryPad(gst_element_get_static_pad(elements.front(), "sink"));
+    gst_pad_add_probe(
+        entryPad.get(),
+        GST_PAD_PROBE_TYPE_BUFFER,
+        branchEntryCallback,
+        this,
+        nullptr);
+
+    auto branchExitCallback =
+        (GstPadProbeReturn (*)(GstPad*, GstPadProbeInfo*, gpointer))
+        [] (GstPad*, GstPadProbeInfo*, gpointer userData) -> GstPadProbeReturn
+    {
+        Ingest* self = static_cast<Ingest*>(userData);
+        if(GST_CLOCK_TIME_IS_VALID(self->_audioBranchEntryTime)) {
+            self->_audioProcessingTime += ThreadCpuTime() - self->_audioBranchEntryTime;
+            self->_audioBranchEntryTime = GST_CLOCK_TIME_NONE;
+        }
+        ++self->_audioBuffers;
+        return GST_PAD_PROBE_OK;
+    };
+    GstPadPtr exitPad(gst_element_get_static_pad(sink, "sink"));
+    gst_pad_add_probe(
+        exitPad.get(),
+        GST_PAD_PROBE_TYPE_BUFFER,
+        branchExitCallback,
+        this,
+        nullptr);
+
+    if(GST_PAD_LINK_OK != gst_pad_link(pad, entryPad.get()))
+        assert(false);
+
+    return true;
+}
+
+Ingest::Stats Ingest::stats() const noexcept
+{
+    Stats stats {
+        .audioMode = _audioMode,
+        .audioBuffers = _audioBuffers,
+        .audioProcessingTime = _audioProcessingTime,
+        .videoQueueTime = 0,
+        .audioQueueTime = 0,
+    };
+
+    if(GstElement* pipeline = _pipelinePtr.get()) {
+        auto queueTime = [pipeline] (const char* name) -> GstClockTime {
+            GstElementPtr queuePtr(gst_bin_get_by_name(GST_BIN(pipeline), name));
+            if(!queuePtr)
+                return 0;
+
+            guint64 time = 0;
+            g_object_get(queuePtr.get(), "current-level-time", &time, nullptr);
+            return time;
+        };
+
+        stats.videoQueueTime = queueTime(VideoQueueName);
+        stats.audioQueueTime = queueTime(AudioQueueName);
+    }
+
+    return stats;
+}
+
+void Ingest::srcPadAdded(
+    GstElement* /*decodebin*/,
+    GstPad* pad)
+{
+    GstElement* pipeline = _pipelinePtr.get();
+
+    GstCapsPtr capsPtr(gst_pad_get_current_caps(pad));
+    GstCaps* caps = capsPtr.get();
+
+    if(gst_caps_is_always_compatible(caps, _h264CapsPtr.get())) {
+        if(_videoLinked) {
+            Log()->error("Multiple video streams not supported");
+            return;
+        }
+
+        GstElementPtr parsePtr(gst_element_factory_make("h264parse", nullptr));
+        GstElement* parse = parsePtr.get();
+        if(!parse) {
+            Log()->error("Failed to create \"h264parse\" element");
+            return;
+        }
+
+        // to allow consumers to join at any keyframe
+        g_object_set(parse, "config-interval", -1, nullptr);
+
+        GstElement* sink = addAppSink(Stream::Video, VideoSinkCaps);
+        if(!sink)
+            return;
+
+        gst_bin_add(GST_BIN(pipeline), parsePtr.release());
+        gst_element_link(parse, sink);
+        gst_element_sync_state_with_parent(parse);
+
+        GstPadPtr parseSinkPad(gst_element_get_static_pad(parse, "sink"));
+        if(GST_PAD_LINK_OK != gst_pad_link(pad, parseSinkPad.get()))
+            assert(false);
+
+        // arrival time travels with the buffer to be matched at mux
+        auto arrivalCallback =
+            (GstPadProbeReturn (*)(GstPad*, GstPadProbeInfo*, gpointer))
+            [] (GstPad*, GstPadProbeInfo* info, gpointer) -> GstPadProbeReturn
+        {
+            GstBuffer* buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+            SetArrivalTime(buffer, LatencyTracker::Now());
+            GST_PAD_PROBE_INFO_DATA(info) = buffer;
+            return GST_PAD_PROBE_OK;
+        };
+        gst_pad_add_probe(
+            pad,
+            GST_PAD_PROBE_TYPE_BUFFER,
+            arrivalCallback,
+            nullptr,
+            nullptr);
+
+        _videoLinked = true;
+    } else if(
+        gst_caps_can_intersect(caps, _aacCapsPtr.get()) ||
+        gst_caps_can_intersect(caps, _mp3CapsPtr.get()))
+    {
+        if(_audioLinked) {
+            Log()->error("Multiple audio streams not supported");
+            return;
+        }
+
+        if(!gst_caps_can_intersect(caps, _flvCompressedAudioCapsPtr.get())) {
+            Log()->warn("Audio stream with sample rate not supported by FLV. Audio skipped.");
+            return;
+        }
+
+        // FLV is able to carry it as is
+        if(!linkAudio(pad, AudioMode::Passthrough))
+            return;
+
+        _audioLinked = true;
+    } else if(gst_caps_is_always_compatible(caps, _audioRawCapsPtr.get())) {
+        if(_audioLinked) {
+            Log()->error("Multiple audio streams not supported");
+            return;
+        }
+
+        // uridecodebin decoded audio FLV can't carry (G.711, Opus, etc.),
+        // so it's encoded to AAC once here
+        if(!linkAudio(pad, AudioMode::Transcode))
+            return;
+
+        _audioLinked = true;
+    } else
+        return;
+}
+
+void Ingest::noMorePads(GstElement* /*decodebin*/)
+{
+    if(!_audioLinked) {
+        // stream silence if there is no audio in source.
+        // precomputed AAC frames are generated following video timestamps,
+        // so there is nothing to add to pipeline
+        _audioMode = AudioMode::Silence;
+        _audioLinked = true;
+    }
+}
+
+// called from video streaming thread with _consumersMutex locked
+void Ingest::deliverSilence(GstSample* videoSample, GstClockTime baseTime)
+{
+    GstBuffer* videoBuffer = gst_sample_get_buffer(videoSample);
+    if(!videoBuffer)
+        return;
+
+    // decoding timestamps are monotonic even with B-frames
+    const GstClockTime videoTime =
+        GST_BUFFER_DTS_IS_VALID(videoBuffer) ?
+            GST_BUFFER_DTS(videoBuffer) :
+            GST_BUFFER_PTS(videoBuffer);
+
+    const GstClockTime processingStart = ThreadCpuTime();
+
+    _silence.generate(
+        videoTime,
+        gst_sample_get_segment(videoSample),
+        [this, baseTime] (GstSample* sample) {
+            for(Consumer* consumer: _consumers)
+                consumer->onSample(Stream::Audio, sample, baseTime);
+
+            ++_audioBuffers;
+        });
+
+    _audioProcessingTime += ThreadCpuTime() - processingStart;
+}
+
+// called from streaming thread
+GstFlowReturn Ingest::onNewSample(Stream stream, GstAppSink* appSink)
+{
+    g_autoptr(GstSample) sample = gst_app_sink_pull_sample(appSink);
+    if(!sample)
+        return GST_FLOW_OK;
+
+    const GstClockTime baseTime = gst_element_get_base_time(GST_ELEMENT(appSink));
+
+    std::lock_guard<std::mutex> lock(_consumersMutex);
+    for(Consumer* consumer: _consumers)
+        consumer->onSample(stream, sample, baseTime);
+
+    if(stream == Stream::Video && _audioMode == AudioMode::Silence)
+        deliverSilence(sample, baseTime);
+
+    return GST_FLOW_OK;
+}
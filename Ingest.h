@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <atomic>
+
+#include <gst/app/gstappsink.h>
+
+#include <CxxPtr/GstPtr.h>
+
+#include "BusWatch.h"
+#include "LogRateLimiter.h"
+#include "SilentAudio.h"
+
+
+// Single connection to the source shared by all consumers of it
+// (RTMP reStreamers and WebRTC preview).
+// Source is demuxed/parsed once and parsed H.264 and audio
+// are handed off to every attached consumer.
+class Ingest
+{
+public:
+    enum class Stream {
+        Video,
+        Audio,
+    };
+
+    enum class AudioMode {
+        None,
+        Passthrough, // compressed audio FLV is able to carry is forwarded as is
+        Transcode, // audio FLV can't carry is encoded to AAC
+        Silence, // source has no audio, precomputed silent AAC frames are generated
+    };
+
+    struct Stats
+    {
+        AudioMode audioMode;
+        guint64 audioBuffers;
+        GstClockTime audioProcessingTime; // CPU time spent on audio branch
+        GstClockTime videoQueueTime; // data waiting for delivery to consumers
+        GstClockTime audioQueueTime;
+    };
+
+    struct Consumer
+    {
+        virtual ~Consumer() {}
+
+        // called from streaming thread.
+        // baseTime is the base time of ingest pipeline,
+        // use RebaseSample() to move sample to the timeline of consumer pipeline
+        virtual void onSample(
+            Stream,
+            GstSample*,
+            GstClockTime baseTime) noexcept = 0;
+    };
+
+    Ingest(
+        const std::string& sourceUrl,
+        GMainContext* busContext, // nullptr - default main context
+        const std::function<void ()>& onPlaying, // i.e. connected
+        const std::function<void ()>& onEos); // pipeline is stopped already, owner has to restart it
+    ~Ingest();
+
+    const std::string& sourceUrl() const { return _sourceUrl; };
+
+    void start() noexcept;
+    // stops source pipeline and reports it as failed to be restarted by owner,
+    // ignored if it was already stopped or (re)started after stalledSince (monotonic time)
+    void reconnect(gint64 stalledSince) noexcept;
+
+    void attach(Consumer*) noexcept;
+    void detach(Consumer*) noexcept;
+    bool hasConsumers() const noexcept;
+
+    Stats stats() const noexcept;
+
+    // returns new sample (transfer full) with shallow copy of the buffer
+    // and timestamps moved from timeline of pipeline with sourceBaseTime
+    // to timeline of pipeline with targetBaseTime.
+    // returns nullptr if sample belongs to the time before target pipeline start.
+    // both pipelines should use the same clock.
+    static GstSample* RebaseSample(
+        GstSample*,
+        GstClockTime sourceBaseTime,
+        GstClockTime targetBaseTime) noexcept;
+
+    // returns clock time of sample DTS (or PTS if DTS is not set)
+    static GstClockTime SampleClockTime(GstSample*, GstClockTime baseTime) noexcept;
+
+    // returns clock time video buffer left source demuxer at,
+    // GST_CLOCK_TIME_NONE if it's unknown
+    static GstClockTime ArrivalTime(GstBuffer*) noexcept;
+    // buffer has to be writable
+    static void SetArrivalTime(GstBuffer*, GstClockTime) noexcept;
+
+private:
+    void stop() noexcept;
+
+    bool onWorkerBusMessage(GstMessage*);
+    void onBusMessage(GstMessage*);
+
+    void srcPadAdded(GstElement* decodebin, GstPad*);
+    void noMorePads(GstElement* decodebin);
+
+    GstElement* addAppSink(Stream, const char* caps);
+    bool linkAudio(GstPad*, AudioMode);
+
+    GstFlowReturn onNewSample(Stream, GstAppSink*);
+    void deliverSilence(GstSample* videoSample, GstClockTime baseTime);
+
+    void onEos(bool error);
+
+private:
+    std::function<void ()> _onPlaying;
+    std::function<void ()> _onEos;
+
+    const std::string _sourceUrl;
+    GMainContext *const _busContext;
+
+    GstElementPtr _pipelinePtr;
+    BusWatch _busWatch;
+    LogRateLimiter _errorLogLimiter;
+    gint64 _startTime = 0; // monotonic time
+
+    GstCapsPtr _h264CapsPtr;
+    GstCapsPtr _aacCapsPtr;
+    GstCapsPtr _mp3CapsPtr;
+    GstCapsPtr _flvCompressedAudioCapsPtr;
+    GstCapsPtr _audioRawCapsPtr;
+
+    bool _videoLinked = false;
+    bool _audioLinked = false;
+
+    std::atomic<AudioMode> _audioMode { AudioMode::None };
+    std::atomic<guint64> _audioBuffers { 0 };
+    std::atomic<GstClockTime> _audioProcessingTime { 0 };
+    // accessed from audio streaming thread only
+    GstClockTime _audioBranchEntryTime = GST_CLOCK_TIME_NONE;
+    // accessed from video streaming thread only
+    SilentAudio _silence;
+
+    mutable std::mutex _consumersMutex;
+    std::set<Consumer*> _consumers;
+};
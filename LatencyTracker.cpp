@@ -0,0 +1,131 @@
+#include "LatencyTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+const std::array<GstClockTime, 17> LatencyTracker::BucketBounds = {
+    1 * GST_MSECOND,
+    2 * GST_MSECOND,
+    5 * GST_MSECOND,
+    10 * GST_MSECOND,
+    20 * GST_MSECOND,
+    50 * GST_MSECOND,
+    100 * GST_MSECOND,
+    200 * GST_MSECOND,
+    300 * GST_MSECOND,
+    500 * GST_MSECOND,
+    750 * GST_MSECOND,
+    1000 * GST_MSECOND,
+    1500 * GST_MSECOND,
+    2000 * GST_MSECOND,
+    3000 * GST_MSECOND,
+    5000 * GST_MSECOND,
+    10000 * GST_MSECOND,
+};
+
+namespace {
+
+// to tolerate rounding of timestamps on the way to mux
+const GstClockTime MatchTolerance = GST_MSECOND;
+
+}
+
+
+GstClockTime LatencyTracker::Now() noexcept
+{
+    g_autoptr(GstClock) clock = gst_system_clock_obtain();
+    return gst_clock_get_time(clock);
+}
+
+void LatencyTracker::arrived(GstClockTime outputTime, GstClockTime arrivalTime) noexcept
+{
+    if(!GST_CLOCK_TIME_IS_VALID(outputTime) || !GST_CLOCK_TIME_IS_VALID(arrivalTime))
+        return;
+
+    const size_t head = _head.load(std::memory_order_relaxed);
+    if(head - _tail.load(std::memory_order_acquire) >= _frames.size())
+        return; // mux is too far behind, frame is not tracked
+
+    _frames[head % _frames.size()] = Frame { outputTime, arrivalTime };
+    _head.store(head + 1, std::memory_order_release);
+}
+
+GstClockTime LatencyTracker::muxed(GstClockTime outputTime) noexcept
+{
+    if(!GST_CLOCK_TIME_IS_VALID(outputTime))
+        return GST_CLOCK_TIME_NONE;
+
+    const size_t head = _head.load(std::memory_order_acquire);
+    size_t tail = _tail.load(std::memory_order_relaxed);
+
+    GstClockTime arrivalTime = GST_CLOCK_TIME_NONE;
+    for(; tail != head; ++tail) {
+        const Frame& frame = _frames[tail % _frames.size()];
+
+        // frames dropped before mux are skipped
+        if(GST_CLOCK_DIFF(frame.outputTime, outputTime) >= GstClockTimeDiff(MatchTolerance))
+            continue;
+
+        // frame arrived after muxed one is kept for the next ones
+        if(GST_CLOCK_DIFF(outputTime, frame.outputTime) >= GstClockTimeDiff(MatchTolerance))
+            break;
+
+        arrivalTime = frame.arrivalTime;
+        ++tail;
+        break;
+    }
+
+    _tail.store(tail, std::memory_order_release);
+
+    return arrivalTime;
+}
+
+void LatencyTracker::sent(GstClockTime arrivalTime) noexcept
+{
+    if(!GST_CLOCK_TIME_IS_VALID(arrivalTime))
+        return;
+
+    const GstClockTime now = Now();
+    const GstClockTime latency = now > arrivalTime ? now - arrivalTime : 0;
+
+    // the first bucket with upper bound not less than latency
+    const size_t bucket =
+        std::lower_bound(BucketBounds.begin(), BucketBounds.end(), latency) - BucketBounds.begin();
+
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(latency, std::memory_order_relaxed);
+}
+
+LatencyTracker::Stats LatencyTracker::stats() const noexcept
+{
+    Stats stats {};
+    for(size_t i = 0; i < BucketsCount; ++i)
+        stats.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+    stats.count = _count.load(std::memory_order_relaxed);
+    stats.sum = _sum.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+GstClockTime LatencyTracker::Stats::percentile(double percentile) const noexcept
+{
+    guint64 total = 0;
+    for(guint64 bucketCount: buckets)
+        total += bucketCount;
+
+    if(!total)
+        return GST_CLOCK_TIME_NONE;
+
+    const guint64 rank = std::max<guint64>(1, std::ceil(total * percentile / 100.));
+
+    guint64 cumulative = 0;
+    for(size_t i = 0; i < BucketBounds.size(); ++i) {
+        cumulative += buckets[i];
+        if(cumulative >= rank)
+            return BucketBounds[i];
+    }
+
+    return GST_CLOCK_TIME_NONE;
+}
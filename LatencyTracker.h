@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include <gst/gst.h>
+
+
+// Matches muxed video frames with the time they left source demuxer,
+// so arrival time can be carried by muxed buffers to RTMP targets,
+// and accumulates the time frames were sent at in fixed-bucket histogram.
+// Lock free: frames are handed from ingest to mux thread with single producer/consumer ring.
+class LatencyTracker
+{
+public:
+    // upper bounds of histogram buckets,
+    // the last bucket (not listed) collects everything above
+    static const std::array<GstClockTime, 17> BucketBounds;
+    static constexpr size_t BucketsCount = 17 + 1;
+
+    struct Stats
+    {
+        std::array<guint64, BucketsCount> buckets;
+        guint64 count;
+        GstClockTime sum;
+
+        // returns upper bound of the bucket containing percentile,
+        // GST_CLOCK_TIME_NONE if there is no data or it's above the last bound
+        GstClockTime percentile(double) const noexcept;
+    };
+
+    // clock used for both arrival and sent time
+    static GstClockTime Now() noexcept;
+
+    // called from ingest streaming thread (by one thread at a time)
+    // for video frames in output order.
+    // outputTime is clock time of the frame on output timeline
+    void arrived(GstClockTime outputTime, GstClockTime arrivalTime) noexcept;
+    // called from mux streaming thread for muxed video frames in output order.
+    // returns arrival time of the frame, GST_CLOCK_TIME_NONE if it's unknown
+    GstClockTime muxed(GstClockTime outputTime) noexcept;
+    // called from target streaming threads
+    void sent(GstClockTime arrivalTime) noexcept;
+
+    Stats stats() const noexcept;
+
+private:
+    struct Frame
+    {
+        GstClockTime outputTime = GST_CLOCK_TIME_NONE;
+        GstClockTime arrivalTime = GST_CLOCK_TIME_NONE;
+    };
+
+    // frames in flight between ingest and mux,
+    // _head is written by producer only, _tail - by consumer only
+    std::array<Frame, 128> _frames;
+    std::atomic<size_t> _head { 0 };
+    std::atomic<size_t> _tail { 0 };
+
+    std::array<std::atomic<guint64>, BucketsCount> _buckets {};
+    std::atomic<guint64> _count { 0 };
+    std::atomic<GstClockTime> _sum { 0 };
+};
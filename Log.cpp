@@ -1,28 +1,76 @@
 #include "Log.h"
 
-#include <spdlog/spdlog.h>
+#include <atomic>
+#include <mutex>
+
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_sinks.h>
 
 
-static std::shared_ptr<spdlog::logger> Logger;
+namespace {
 
-void InitReStreamerLogger(spdlog::level::level_enum level)
+enum {
+    QUEUE_SIZE = 8192, // messages
+};
+
+#ifndef NDEBUG
+const spdlog::level::level_enum DefaultLevel = spdlog::level::debug;
+#else
+const spdlog::level::level_enum DefaultLevel = spdlog::level::info;
+#endif
+
+// logger is reached from worker contexts and streaming threads,
+// so it's created exactly once whoever is the first
+std::once_flag LoggerCreated;
+std::shared_ptr<spdlog::details::thread_pool> ThreadPool;
+std::shared_ptr<spdlog::logger> Logger;
+std::atomic<std::uint64_t> Suppressed { 0 };
+
+void CreateLogger(spdlog::level::level_enum level)
 {
-    spdlog::sink_ptr sink = std::make_shared<spdlog::sinks::stdout_sink_st>();
+    spdlog::sink_ptr sink = std::make_shared<spdlog::sinks::stdout_sink_mt>();
+
+    // async logger refers thread pool weakly
+    ThreadPool = std::make_shared<spdlog::details::thread_pool>(QUEUE_SIZE, 1);
 
-    Logger = std::make_shared<spdlog::logger>("VKStreamer", sink);
+    Logger = std::make_shared<spdlog::async_logger>(
+        "VKStreamer",
+        sink,
+        ThreadPool,
+        spdlog::async_overflow_policy::overrun_oldest);
 
     Logger->set_level(level);
+    Logger->flush_on(spdlog::level::err);
+}
+
+}
+
+void InitReStreamerLogger(spdlog::level::level_enum level)
+{
+    std::call_once(LoggerCreated, CreateLogger, level);
+
+    // logger could be already created with default level by the first message
+    Logger->set_level(level);
 }
 
 const std::shared_ptr<spdlog::logger>& ReStreamerLog()
 {
-    if(!Logger)
-#ifndef NDEBUG
-        InitReStreamerLogger(spdlog::level::debug);
-#else
-        InitReStreamerLogger(spdlog::level::info);
-#endif
+    std::call_once(LoggerCreated, CreateLogger, DefaultLevel);
 
     return Logger;
 }
+
+ReStreamerLogStats ReStreamerLogStatistics() noexcept
+{
+    ReStreamerLog();
+
+    return ReStreamerLogStats {
+        .dropped = ThreadPool->overrun_counter(),
+        .suppressed = Suppressed,
+    };
+}
+
+void CountSuppressedLogMessages(unsigned count) noexcept
+{
+    Suppressed += count;
+}
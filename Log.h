@@ -1,10 +1,25 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
 
 #include <spdlog/spdlog.h>
 
 
+// messages are formatted in place and written to stdout by dedicated thread,
+// so logging never blocks caller even if stdout is slow.
+// has to be called before any worker thread is started,
+// otherwise logger is created with default level on the first use
 void InitReStreamerLogger(spdlog::level::level_enum level);
 
 const std::shared_ptr<spdlog::logger>& ReStreamerLog();
+
+struct ReStreamerLogStats
+{
+    std::uint64_t dropped; // the oldest messages dropped on log queue overflow
+    std::uint64_t suppressed; // messages suppressed by LogRateLimiter
+};
+
+ReStreamerLogStats ReStreamerLogStatistics() noexcept;
+
+void CountSuppressedLogMessages(unsigned count) noexcept;
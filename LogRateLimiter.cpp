@@ -0,0 +1,32 @@
+#include "LogRateLimiter.h"
+
+#include "Log.h"
+
+
+LogRateLimiter::LogRateLimiter(unsigned burst, unsigned period) :
+    _burst(burst), _period(static_cast<gint64>(period) * 1000)
+{
+}
+
+bool LogRateLimiter::allow(unsigned* suppressed) noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const gint64 now = g_get_monotonic_time();
+    if(!_periodStart || now - _periodStart >= _period) {
+        _periodStart = now;
+        _allowed = 0;
+    }
+
+    if(_allowed >= _burst) {
+        ++_suppressed;
+        CountSuppressedLogMessages(1);
+        return false;
+    }
+
+    ++_allowed;
+    *suppressed = _suppressed;
+    _suppressed = 0;
+
+    return true;
+}
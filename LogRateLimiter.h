@@ -0,0 +1,31 @@
+#pragma once
+
+#include <mutex>
+
+#include <glib.h>
+
+
+// Lets through bursts of messages of single kind
+// (e.g. errors of single pipeline) and suppresses the rest till the end of period,
+// so outage affecting a lot of reStreamers doesn't flood log.
+class LogRateLimiter
+{
+public:
+    LogRateLimiter(
+        unsigned burst = 5, // messages allowed per period
+        unsigned period = 10000); // ms
+
+    // thread safe
+    // returns false if message has to be suppressed,
+    // otherwise sets suppressed to count of messages suppressed since the last allowed one
+    bool allow(unsigned* suppressed) noexcept;
+
+private:
+    const unsigned _burst;
+    const gint64 _period; // us
+
+    std::mutex _mutex;
+    gint64 _periodStart = 0; // monotonic time
+    unsigned _allowed = 0; // inside current period
+    unsigned _suppressed = 0; // since the last allowed message
+};
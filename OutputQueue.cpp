@@ -0,0 +1,142 @@
+#include "OutputQueue.h"
+
+#include <gst/app/gstappsrc.h>
+
+#include "Log.h"
+#include "Ingest.h"
+
+
+static const auto Log = ReStreamerLog;
+
+
+OutputQueue::OutputQueue(const Config::QueueBudget& budget) :
+    _budget(budget)
+{
+}
+
+void OutputQueue::setAppSrc(GstElementPtr&& appSrcPtr) noexcept
+{
+    GstElement* appSrc = appSrcPtr.get();
+
+    g_object_set(appSrc,
+        "is-live", TRUE,
+        "format", GST_FORMAT_TIME,
+        "block", FALSE,
+        "max-bytes", static_cast<guint64>(_budget.maxBytes),
+        "max-time", static_cast<guint64>(_budget.maxLatency * GST_MSECOND),
+        nullptr);
+
+    if(_budget.overflowPolicy == Config::QueueBudget::OverflowPolicy::DropOld)
+        gst_util_set_object_arg(G_OBJECT(appSrc), "leaky-type", "downstream");
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _appSrcPtr = std::move(appSrcPtr);
+}
+
+void OutputQueue::setBaseTime(GstClockTime baseTime) noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _baseTime = baseTime;
+}
+
+void OutputQueue::reset() noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _appSrcPtr.reset();
+    _baseTime = GST_CLOCK_TIME_NONE;
+    _streaming = false;
+    _overflow = false;
+}
+
+void OutputQueue::resync() noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _streaming = false;
+}
+
+bool OutputQueue::isStreaming() const noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _streaming;
+}
+
+bool OutputQueue::isOverBudget(GstElement* appSrc) const noexcept
+{
+    GstAppSrc* src = GST_APP_SRC(appSrc);
+
+    if(_budget.maxBytes && gst_app_src_get_current_level_bytes(src) >= _budget.maxBytes)
+        return true;
+
+    if(_budget.maxLatency &&
+        gst_app_src_get_current_level_time(src) >= _budget.maxLatency * GST_MSECOND)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+void OutputQueue::push(GstSample* sample, GstClockTime sourceBaseTime) noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    GstElement* appSrc = _appSrcPtr.get();
+    if(!appSrc || !GST_CLOCK_TIME_IS_VALID(_baseTime))
+        return; // output pipeline is not playing yet
+
+    g_autoptr(GstSample) rebasedSample =
+        Ingest::RebaseSample(sample, sourceBaseTime, _baseTime);
+    if(!rebasedSample)
+        return;
+
+    // with DropOld policy appsrc drops the oldest data itself
+    if(_budget.overflowPolicy == Config::QueueBudget::OverflowPolicy::DropNew) {
+        if(isOverBudget(appSrc)) {
+            if(!_overflow) {
+                Log()->warn("Output queue overflow. Dropping data until queue drains...");
+                _overflow = true;
+                _streaming = false;
+            }
+
+            ++_droppedBuffers;
+            return;
+        }
+    }
+
+    if(!_streaming) {
+        // codec data and headers are carried by caps,
+        // so it's enough to resume from any keyframe
+        GstBuffer* buffer = gst_sample_get_buffer(rebasedSample);
+        if(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT) ||
+            GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_HEADER))
+        {
+            if(_overflow)
+                ++_droppedBuffers;
+            return;
+        }
+
+        _streaming = true;
+        _overflow = false;
+    }
+
+    gst_app_src_push_sample(GST_APP_SRC(appSrc), rebasedSample);
+}
+
+OutputQueue::Stats OutputQueue::stats() const noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Stats stats {
+        .bytes = 0,
+        .time = 0,
+        .droppedBuffers = _droppedBuffers,
+    };
+
+    if(GstElement* appSrc = _appSrcPtr.get()) {
+        GstAppSrc* src = GST_APP_SRC(appSrc);
+        stats.bytes = gst_app_src_get_current_level_bytes(src);
+        stats.time = gst_app_src_get_current_level_time(src);
+    }
+
+    return stats;
+}
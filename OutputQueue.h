@@ -0,0 +1,51 @@
+#pragma once
+
+#include <mutex>
+
+#include <CxxPtr/GstPtr.h>
+
+#include "Config.h"
+
+
+// appsrc at the head of output pipeline
+// decoupling it from streaming thread of the producer,
+// with queue size limited by Config::QueueBudget
+class OutputQueue
+{
+public:
+    struct Stats
+    {
+        guint64 bytes;
+        GstClockTime time;
+        guint64 droppedBuffers;
+    };
+
+    explicit OutputQueue(const Config::QueueBudget&);
+
+    void setAppSrc(GstElementPtr&&) noexcept;
+    void setBaseTime(GstClockTime) noexcept; // base time of output pipeline
+    void reset() noexcept;
+    // drop data until the next sync point (keyframe)
+    void resync() noexcept;
+
+    // true after the first sync point (keyframe) was pushed
+    bool isStreaming() const noexcept;
+
+    // called from producer streaming thread
+    void push(GstSample*, GstClockTime sourceBaseTime) noexcept;
+
+    Stats stats() const noexcept;
+
+private:
+    bool isOverBudget(GstElement* appSrc) const noexcept;
+
+private:
+    const Config::QueueBudget _budget;
+
+    mutable std::mutex _mutex;
+    GstElementPtr _appSrcPtr;
+    GstClockTime _baseTime = GST_CLOCK_TIME_NONE;
+    bool _streaming = false;
+    bool _overflow = false;
+    guint64 _droppedBuffers = 0;
+};
@@ -0,0 +1,130 @@
+#include "PreviewSource.h"
+
+#include <cassert>
+
+#include <gst/app/gstappsrc.h>
+
+#include <CxxPtr/GlibPtr.h>
+
+#include "Log.h"
+
+
+static const auto Log = ReStreamerLog;
+
+
+PreviewSource::PreviewSource(
+    const std::string& sourceUrl,
+    const std::string& forceH264ProfileLevelId,
+    const AttachCallback& attach,
+    const DetachCallback& detach) :
+    _sourceUrl(sourceUrl),
+    _forceH264ProfileLevelId(forceH264ProfileLevelId),
+    _attach(attach),
+    _detach(detach)
+{
+}
+
+PreviewSource::~PreviewSource()
+{
+    cleanup();
+}
+
+bool PreviewSource::prepare() noexcept
+{
+    std::string pipelineDesc =
+        "appsrc name=src is-live=true format=time ! "
+        "h264parse config-interval=-1 ! "
+        "rtph264pay pt=96 config-interval=-1 ! ";
+    if(!_forceH264ProfileLevelId.empty()) {
+        pipelineDesc +=
+            "capssetter caps=\"application/x-rtp, profile-level-id=(string)" +
+            _forceH264ProfileLevelId + "\" ! ";
+    }
+    pipelineDesc += "tee name=tee allow-not-linked=true";
+
+    g_autoptr(GError) parseError = nullptr;
+    GstElementPtr pipelinePtr(gst_parse_launch(pipelineDesc.c_str(), &parseError));
+    if(parseError) {
+        Log()->error("Failed to create preview pipeline: {}", parseError->message);
+        return false;
+    }
+
+    GstElement* pipeline = pipelinePtr.get();
+
+    // has to share clock with ingest pipeline
+    g_autoptr(GstClock) clock = gst_system_clock_obtain();
+    gst_pipeline_use_clock(GST_PIPELINE(pipeline), clock);
+
+    _appSrcPtr.reset(gst_bin_get_by_name(GST_BIN(pipeline), "src"));
+    GstElementPtr teePtr(gst_bin_get_by_name(GST_BIN(pipeline), "tee"));
+    _tee = teePtr.get();
+
+    setPipeline(std::move(pipelinePtr));
+    setTee(std::move(teePtr));
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    _attach(this);
+    _attached = true;
+
+    return true;
+}
+
+void PreviewSource::cleanup() noexcept
+{
+    if(_attached) {
+        // after detach no more samples will be delivered
+        _detach(this);
+        _attached = false;
+    }
+
+    _baseTime = GST_CLOCK_TIME_NONE;
+    _appSrcPtr.reset();
+    _tee = nullptr;
+
+    GstStreamingSource::cleanup();
+}
+
+// every peer is linked to own tee request pad
+bool PreviewSource::inUse() const noexcept
+{
+    if(!_tee)
+        return false;
+
+    GST_OBJECT_LOCK(_tee);
+    const bool linked = _tee->numsrcpads > 0;
+    GST_OBJECT_UNLOCK(_tee);
+
+    return linked;
+}
+
+// called from ingest streaming thread
+void PreviewSource::onSample(
+    Ingest::Stream stream,
+    GstSample* sample,
+    GstClockTime baseTime) noexcept
+{
+    if(stream != Ingest::Stream::Video)
+        return; // preview is video only
+
+    GstElement* appSrc = _appSrcPtr.get();
+
+    GstClockTime pipelineBaseTime = _baseTime;
+    if(!GST_CLOCK_TIME_IS_VALID(pipelineBaseTime)) {
+        GstState state;
+        if(GST_STATE_CHANGE_SUCCESS != gst_element_get_state(appSrc, &state, nullptr, 0) ||
+            state != GST_STATE_PLAYING)
+        {
+            return;
+        }
+
+        pipelineBaseTime = _baseTime = gst_element_get_base_time(appSrc);
+    }
+
+    g_autoptr(GstSample) rebasedSample =
+        Ingest::RebaseSample(sample, baseTime, pipelineBaseTime);
+    if(!rebasedSample)
+        return;
+
+    gst_app_src_push_sample(GST_APP_SRC(appSrc), rebasedSample);
+}
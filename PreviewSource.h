@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <atomic>
+
+#include "WebRTSP/RtStreaming/GstRtStreaming/GstStreamingSource.h"
+
+#include "Ingest.h"
+
+
+// WebRTC preview fed by the shared Ingest of the source
+// instead of own connection to the source
+class PreviewSource : public GstStreamingSource, private Ingest::Consumer
+{
+public:
+    typedef std::function<void (Ingest::Consumer*)> AttachCallback;
+    typedef std::function<void (Ingest::Consumer*)> DetachCallback;
+
+    PreviewSource(
+        const std::string& sourceUrl,
+        const std::string& forceH264ProfileLevelId,
+        const AttachCallback&,
+        const DetachCallback&);
+    ~PreviewSource();
+
+    const std::string& sourceUrl() const { return _sourceUrl; };
+
+    // some WebRTC peer is fed by preview
+    bool inUse() const noexcept;
+
+protected:
+    bool prepare() noexcept override;
+    void cleanup() noexcept override;
+
+private:
+    void onSample(
+        Ingest::Stream,
+        GstSample*,
+        GstClockTime baseTime) noexcept override;
+
+private:
+    const std::string _sourceUrl;
+    const std::string _forceH264ProfileLevelId;
+
+    const AttachCallback _attach;
+    const DetachCallback _detach;
+
+    bool _attached = false;
+
+    GstElementPtr _appSrcPtr;
+    GstElement* _tee = nullptr; // owned by pipeline
+    std::atomic<GstClockTime> _baseTime { GST_CLOCK_TIME_NONE };
+};
@@ -0,0 +1,216 @@
+#include "RTMPTarget.h"
+
+#include <cassert>
+
+#include <CxxPtr/GlibPtr.h>
+
+#include "Log.h"
+#include "Ingest.h"
+
+
+static const auto Log = ReStreamerLog;
+
+
+RTMPTarget::RTMPTarget(
+    const std::string& targetUrl,
+    const Config::QueueBudget& queueBudget,
+    GMainContext* busContext,
+    LatencyTracker* latency,
+    const std::function<void ()>& onPlaying,
+    const std::function<void ()>& onEos) :
+    _onPlaying(onPlaying), _onEos(onEos), _targetUrl(targetUrl), _busContext(busContext),
+    _latency(latency), _queue(queueBudget)
+{
+}
+
+RTMPTarget::~RTMPTarget()
+{
+    stop();
+}
+
+void RTMPTarget::stop() noexcept
+{
+    _queue.reset();
+
+    _busWatch.remove();
+
+    _playing = false;
+
+    if(_pipelinePtr) {
+        gst_element_set_state(_pipelinePtr.get(), GST_STATE_NULL);
+        _pipelinePtr.reset();
+    }
+}
+
+// called on bus worker context
+bool RTMPTarget::onWorkerBusMessage(GstMessage* message)
+{
+    switch(GST_MESSAGE_TYPE(message)) {
+        case GST_MESSAGE_STATE_CHANGED: {
+            GstElement* pipeline = _pipelinePtr.get();
+            if(GST_MESSAGE_SRC(message) != GST_OBJECT(pipeline))
+                break;
+
+            GstState newState;
+            gst_message_parse_state_changed(message, nullptr, &newState, nullptr);
+            if(newState == GST_STATE_PLAYING) {
+                _queue.setBaseTime(gst_element_get_base_time(pipeline));
+                _playing = true;
+                return true;
+            }
+            break;
+        }
+        case GST_MESSAGE_EOS: {
+            unsigned suppressed;
+            if(_errorLogLimiter.allow(&suppressed)) {
+                if(suppressed)
+                    Log()->warn("{} errors from RTMP target were suppressed", suppressed);
+
+                Log()->error("Got EOS from RTMP target pipeline");
+            }
+            return true;
+        }
+        case GST_MESSAGE_ERROR: {
+            g_autofree gchar* debug = nullptr;
+            g_autoptr(GError) error = nullptr;
+            gst_message_parse_error(message, &error, &debug);
+
+            // target url is not logged since it contains stream key
+            unsigned suppressed;
+            if(_errorLogLimiter.allow(&suppressed)) {
+                if(suppressed)
+                    Log()->warn("{} errors from RTMP target were suppressed", suppressed);
+
+                Log()->error("Got error from RTMP target pipeline: {}", error->message);
+                if(debug)
+                    Log()->debug("{}", debug);
+            }
+
+            return true;
+        }
+        default:
+            break;
+    }
+
+    return false;
+}
+
+void RTMPTarget::onBusMessage(GstMessage* message)
+{
+    switch(GST_MESSAGE_TYPE(message)) {
+        case GST_MESSAGE_STATE_CHANGED:
+            // only pipeline PLAYING state is forwarded from worker
+            _onPlaying();
+            break;
+        case GST_MESSAGE_EOS:
+        case GST_MESSAGE_ERROR:
+            stop();
+            // restart is scheduled by owner
+            _onEos();
+            break;
+        default:
+            break;
+    }
+}
+
+void RTMPTarget::start() noexcept
+{
+    stop();
+
+    GstElementPtr pipelinePtr(gst_pipeline_new(nullptr));
+    GstElement* pipeline = pipelinePtr.get();
+    if(!pipeline) {
+        Log()->error("Failed to create pipeline element");
+        return;
+    }
+
+    // has to share clock with mux pipeline
+    g_autoptr(GstClock) clock = gst_system_clock_obtain();
+    gst_pipeline_use_clock(GST_PIPELINE(pipeline), clock);
+
+    GstElementPtr appSrcPtr(gst_element_factory_make("appsrc", nullptr));
+    GstElement* appSrc = appSrcPtr.get();
+    if(!appSrc) {
+        Log()->error("Failed to create \"appsrc\" element");
+        return;
+    }
+
+    // "file://" targets are used by benchmarks to take RTMP server out of measurements
+    const bool fileTarget = gst_uri_has_protocol(_targetUrl.c_str(), "file");
+    GstElementPtr rtmpSinkPtr(
+        fileTarget ?
+            gst_element_make_from_uri(GST_URI_SINK, _targetUrl.c_str(), nullptr, nullptr) :
+            gst_element_factory_make("rtmpsink", nullptr));
+    GstElement* rtmpSink = rtmpSinkPtr.get();
+    if(!rtmpSink) {
+        Log()->error("Failed to create \"{}\" element", fileTarget ? "filesink" : "rtmpsink");
+        return;
+    }
+
+    if(!fileTarget) {
+        g_object_set(rtmpSink, "location", _targetUrl.c_str(), nullptr);
+    } else if(g_object_class_find_property(G_OBJECT_GET_CLASS(rtmpSink), "buffer-mode")) {
+        // filesink buffering would delay output unlike TCP connection of rtmpsink
+        gst_util_set_object_arg(G_OBJECT(rtmpSink), "buffer-mode", "unbuffered");
+    }
+
+    gst_object_ref(appSrc);
+    gst_bin_add_many(
+        GST_BIN(pipeline),
+        appSrc, rtmpSinkPtr.release(),
+        nullptr);
+    gst_element_link(appSrc, rtmpSink);
+
+    GstPadPtr rtmpSinkPadPtr(gst_element_get_static_pad(rtmpSink, "sink"));
+    _sent.attach(rtmpSinkPadPtr.get());
+    gst_pad_add_probe(
+        rtmpSinkPadPtr.get(),
+        GST_PAD_PROBE_TYPE_BUFFER,
+        onSentProbe,
+        this,
+        nullptr);
+
+    _pipelinePtr = std::move(pipelinePtr);
+
+    _queue.setAppSrc(std::move(appSrcPtr));
+
+    _busWatch.add(
+        pipeline,
+        _busContext,
+        [this] (GstMessage* message) { return onWorkerBusMessage(message); },
+        [this] (GstMessage* message) { onBusMessage(message); });
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+}
+
+// called from target streaming thread
+GstPadProbeReturn RTMPTarget::onSentProbe(
+    GstPad*,
+    GstPadProbeInfo* info,
+    gpointer userData)
+{
+    RTMPTarget* self = static_cast<RTMPTarget*>(userData);
+
+    // only muxed video frames carry arrival time
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    self->_latency->sent(Ingest::ArrivalTime(buffer));
+
+    return GST_PAD_PROBE_OK;
+}
+
+// called from mux streaming thread
+void RTMPTarget::push(GstSample* sample, GstClockTime baseTime) noexcept
+{
+    // FLV header and codec data are taken from caps "streamheader" by rtmpsink,
+    // so (re)connected target joins at any keyframe
+    _queue.push(sample, baseTime);
+}
+
+RTMPTarget::Stats RTMPTarget::stats() const noexcept
+{
+    return Stats {
+        .queue = _queue.stats(),
+        .playing = _playing,
+        .sentBytes = _sent.stats().bytes,
+    };
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <atomic>
+
+#include <CxxPtr/GstPtr.h>
+
+#include "Config.h"
+#include "BusWatch.h"
+#include "LogRateLimiter.h"
+#include "OutputQueue.h"
+#include "TrafficCounter.h"
+#include "LatencyTracker.h"
+
+
+// Single RTMP connection fed with already muxed FLV stream.
+// Lives in own pipeline to not affect other targets of the same reStreamer,
+// on failure pipeline is stopped and owner has to restart it.
+class RTMPTarget
+{
+public:
+    struct Stats
+    {
+        OutputQueue::Stats queue;
+        bool playing; // pipeline reached PLAYING state
+        guint64 sentBytes; // FLV data handed to rtmpsink
+    };
+
+    RTMPTarget(
+        const std::string& targetUrl,
+        const Config::QueueBudget&,
+        GMainContext* busContext, // nullptr - default main context
+        LatencyTracker*, // has to outlive target
+        const std::function<void ()>& onPlaying, // i.e. connected
+        const std::function<void ()>& onEos);
+    ~RTMPTarget();
+
+    const std::string& targetUrl() const { return _targetUrl; };
+
+    void start() noexcept;
+
+    // called from streaming thread
+    void push(GstSample*, GstClockTime baseTime) noexcept;
+
+    Stats stats() const noexcept;
+
+private:
+    void stop() noexcept;
+
+    static GstPadProbeReturn onSentProbe(GstPad*, GstPadProbeInfo*, gpointer userData);
+
+    bool onWorkerBusMessage(GstMessage*);
+    void onBusMessage(GstMessage*);
+
+private:
+    std::function<void ()> _onPlaying;
+    std::function<void ()> _onEos;
+
+    const std::string _targetUrl;
+    GMainContext *const _busContext;
+    LatencyTracker *const _latency;
+
+    GstElementPtr _pipelinePtr;
+    BusWatch _busWatch;
+    LogRateLimiter _errorLogLimiter;
+    std::atomic<bool> _playing { false };
+    TrafficCounter _sent;
+
+    // slow TCP write blocks only own streaming thread of this queue
+    OutputQueue _queue;
+};
@@ -1,85 +1,227 @@
 #include "ReStreamer.h"
 
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 
 #include <CxxPtr/GlibPtr.h>
 
 #include "Log.h"
+#include "Slate.h"
 
 
 static const auto Log = ReStreamerLog;
 
+namespace {
 
-ReStreamer::ReStreamer(
-    const std::string& sourceUrl,
-    const std::string& targetUrl,
-    const std::function<void ()>& onEos) :
-    _onEos(onEos), _sourceUrl(sourceUrl), _targetUrl(targetUrl)
+// used as distance between the last frame before source outage
+// and the first frame after if frame duration is unknown
+const GstClockTime DefaultFrameDuration = 40 * GST_MSECOND;
+
+const unsigned MinWatchdogInterval = 50; // ms
+
+// fallback frames are repeated keyframes, so they are sent with low rate
+const unsigned FallbackFrameInterval = 200; // ms
+const gint64 FallbackDelay = 1000; // ms without video from source to switch to fallback
+const gint64 StreamingTimeout = 1000; // ms without video from source to report it's not streaming
+
+const guint8 FlvVideoTag = 9; // the first byte of FLV tag
+const gsize FlvTagHeaderSize = 11;
+const gsize FlvAvcHeaderSize = 5; // frame type and codec id, AVC packet type, composition time
+
+// muxed timestamps are rounded to FLV milliseconds
+const GstClockTime CodecChangeTolerance = GST_MSECOND;
+
+bool IsKeyFrame(GstBuffer* buffer)
 {
+    return
+        !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT) &&
+        !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_HEADER);
 }
 
-ReStreamer::~ReStreamer()
+GstBuffer* CodecData(GstCaps* caps)
 {
-    stop();
+    const GstStructure* structure = gst_caps_get_structure(caps, 0);
+    const GValue* value = gst_structure_get_value(structure, "codec_data");
+    return value && GST_VALUE_HOLDS_BUFFER(value) ? gst_value_get_buffer(value) : nullptr;
 }
 
-void ReStreamer::setState(GstState state) noexcept
+bool SameCodecData(GstCaps* l, GstCaps* r)
 {
-    if(!_pipelinePtr) {
-        if(state != GST_STATE_NULL)
-            ;
-        return;
-    }
+    GstBuffer* lData = CodecData(l);
+    GstBuffer* rData = CodecData(r);
+    if(!lData || !rData)
+        return lData == rData;
+
+    const gsize size = gst_buffer_get_size(lData);
+    if(gst_buffer_get_size(rData) != size)
+        return false;
+
+    GstMapInfo map;
+    if(!gst_buffer_map(rData, &map, GST_MAP_READ))
+        return false;
+    const bool same = gst_buffer_memcmp(lData, 0, map.data, size) == 0;
+    gst_buffer_unmap(rData, &map);
+
+    return same;
+}
 
-    GstElement* pipeline = _pipelinePtr.get();
+// AVC sequence header tag with the same timestamp as muxed video tag
+GstSample* SequenceHeaderTag(GstSample* videoTag, GstCaps* videoCaps)
+{
+    GstBuffer* codecData = CodecData(videoCaps);
+    if(!codecData)
+        return nullptr;
+
+    GstBuffer* tag = gst_sample_get_buffer(videoTag);
+    guint8 timestamp[4]; // with extended byte
+    if(gst_buffer_extract(tag, 4, timestamp, sizeof(timestamp)) != sizeof(timestamp))
+        return nullptr;
+
+    const gsize codecDataSize = gst_buffer_get_size(codecData);
+    const gsize dataSize = FlvAvcHeaderSize + codecDataSize;
+    const gsize tagSize = FlvTagHeaderSize + dataSize;
+
+    // followed by previous tag size
+    g_autoptr(GstBuffer) header = gst_buffer_new_allocate(nullptr, tagSize + 4, nullptr);
+    GstMapInfo map;
+    if(!gst_buffer_map(header, &map, GST_MAP_WRITE))
+        return nullptr;
+
+    guint8* data = map.data;
+    data[0] = FlvVideoTag;
+    GST_WRITE_UINT24_BE(data + 1, dataSize);
+    memcpy(data + 4, timestamp, sizeof(timestamp));
+    GST_WRITE_UINT24_BE(data + 8, 0); // stream id
+    data[11] = 0x17; // keyframe, AVC
+    data[12] = 0; // AVC sequence header
+    GST_WRITE_UINT24_BE(data + 13, 0); // composition time
+    gst_buffer_extract(codecData, 0, data + FlvTagHeaderSize + FlvAvcHeaderSize, codecDataSize);
+    GST_WRITE_UINT32_BE(data + tagSize, tagSize);
+
+    gst_buffer_unmap(header, &map);
+
+    GST_BUFFER_PTS(header) = GST_BUFFER_PTS(tag);
+    GST_BUFFER_DTS(header) = GST_BUFFER_DTS(tag);
+
+    return gst_sample_new(
+        header,
+        gst_sample_get_caps(videoTag),
+        gst_sample_get_segment(videoTag),
+        nullptr);
+}
 
-    switch(gst_element_set_state(pipeline, state)) {
-        case GST_STATE_CHANGE_FAILURE:
-            break;
-        case GST_STATE_CHANGE_SUCCESS:
-            break;
-        case GST_STATE_CHANGE_ASYNC:
-            break;
-        case GST_STATE_CHANGE_NO_PREROLL:
-            break;
-    }
 }
 
-void ReStreamer::pause() noexcept
+
+ReStreamer::ReStreamer(
+    Ingest* ingest,
+    const Config::ReStreamer& config,
+    GMainContext* busContext,
+    const std::function<void (size_t target)>& onTargetPlaying,
+    const std::function<void (size_t target)>& onTargetEos,
+    const std::function<void ()>& onPlaying,
+    const std::function<void ()>& onEos) :
+    _onPlaying(onPlaying), _onEos(onEos), _ingest(ingest), _busContext(busContext),
+    _stallTimeout(config.stallTimeout),
+    _videoQueue(config.queueBudget), _audioQueue(config.queueBudget),
+    _fallbackMode(config.fallback), _fallbackImage(config.fallbackImage)
 {
-    setState(GST_STATE_PAUSED);
+    gst_segment_init(&_fallbackSegment, GST_FORMAT_TIME);
+
+    for(const std::string& targetUrl: config.targetUrls) {
+        const size_t target = _targets.size();
+        _targets.emplace_back(
+            targetUrl,
+            config.queueBudget,
+            busContext,
+            &_latency,
+            [this, onTargetPlaying, target] () {
+                onTargetPlaying(target);
+                targetConnected(target);
+            },
+            [onTargetEos, target] () { onTargetEos(target); });
+    }
 }
 
-void ReStreamer::play() noexcept
+ReStreamer::~ReStreamer()
 {
-    setState(GST_STATE_PLAYING);
+    _watchdogTimer.remove();
+    _fallbackTimer.remove();
+
+    _ingest->detach(this);
+
+    _videoQueue.reset();
+    _audioQueue.reset();
+
+    _busWatch.remove();
+
+    stop();
 }
 
 void ReStreamer::stop() noexcept
 {
-    setState(GST_STATE_NULL);
+    if(_pipelinePtr)
+        gst_element_set_state(_pipelinePtr.get(), GST_STATE_NULL);
 }
 
-gboolean ReStreamer::onBusMessage(GstMessage* message)
+// called on bus worker context
+bool ReStreamer::onWorkerBusMessage(GstMessage* message)
 {
     switch(GST_MESSAGE_TYPE(message)) {
-        case GST_MESSAGE_EOS:
-            onEos(false);
+        case GST_MESSAGE_STATE_CHANGED: {
+            GstElement* pipeline = _pipelinePtr.get();
+            if(GST_MESSAGE_SRC(message) != GST_OBJECT(pipeline))
+                break;
+
+            GstState newState;
+            gst_message_parse_state_changed(message, nullptr, &newState, nullptr);
+            if(newState == GST_STATE_PLAYING) {
+                const GstClockTime baseTime = gst_element_get_base_time(pipeline);
+                _videoQueue.setBaseTime(baseTime);
+                _audioQueue.setBaseTime(baseTime);
+            }
             break;
+        }
+        case GST_MESSAGE_EOS:
+            return true;
         case GST_MESSAGE_ERROR: {
             g_autofree gchar* debug = nullptr;
             g_autoptr(GError) error = nullptr;
             gst_message_parse_error(message, &error, &debug);
 
-            if(debug) {
-                Log()->error("Got error from GStreamer pipeline:\n{}\n{}", error->message, debug);
-            } else {
-                Log()->error("Got error from GStreamer pipeline:\n{}", error->message);
+            unsigned suppressed;
+            if(_errorLogLimiter.allow(&suppressed)) {
+                if(suppressed)
+                    Log()->warn("{} errors from \"{}\" reStreamer were suppressed", suppressed, sourceUrl());
+
+                Log()->error("Got error from \"{}\" reStreamer pipeline: {}", sourceUrl(), error->message);
+                if(debug)
+                    Log()->debug("{}", debug);
             }
 
+            return true;
+        }
+        case GST_MESSAGE_APPLICATION:
+            if(gst_message_has_name(message, "stall"))
+                return true;
+            break;
+        default:
+            break;
+    }
+
+    return false;
+}
+
+void ReStreamer::onBusMessage(GstMessage* message)
+{
+    switch(GST_MESSAGE_TYPE(message)) {
+        case GST_MESSAGE_EOS:
+            onEos(false);
+            break;
+        case GST_MESSAGE_ERROR:
             onEos(true);
             break;
-        }
         case GST_MESSAGE_APPLICATION: {
             const GstStructure* structure =
                 gst_message_get_structure(message);
@@ -87,20 +229,17 @@ gboolean ReStreamer::onBusMessage(GstMessage* message)
             if(!structure)
                 break;
 
-            if(gst_message_has_name(message, "eos")) {
-                Log()->error("Got EOS from GStreamer pipeline");
-
-                gboolean error = FALSE;
-                gst_structure_get_boolean(structure, "error", &error);
-                onEos(error != FALSE);
+            if(gst_structure_has_name(structure, "stall")) {
+                gint64 stalledSince = 0;
+                gst_structure_get_int64(structure, "since", &stalledSince);
+                // the other reStreamers of the same source could detect the same stall
+                _ingest->reconnect(stalledSince);
             }
             break;
         }
         default:
             break;
     }
-
-    return TRUE;
 }
 
 void ReStreamer::onEos(bool /*error*/)
@@ -108,27 +247,21 @@ void ReStreamer::onEos(bool /*error*/)
     _onEos();
 }
 
-
-// called from streaming thread
-void ReStreamer::postEos(
-    GstElement* rtcbin,
-    gboolean error)
+void ReStreamer::targetConnected(size_t target) noexcept
 {
-    GstStructure* structure =
-        gst_structure_new(
-            "eos",
-            "error", G_TYPE_BOOLEAN, error,
-            nullptr);
-
-    GstMessage* message =
-        gst_message_new_application(GST_OBJECT(rtcbin), structure);
+    if(!_targetsConnecting[target])
+        return;
 
-    GstBusPtr busPtr(gst_element_get_bus(rtcbin));
-    gst_bus_post(busPtr.get(), message);
+    _targetsConnecting[target] = false;
+    if(--_targetsConnectingCount == 0)
+        _onPlaying();
 }
 
+
 void ReStreamer::start() noexcept
 {
+    _startTime = g_get_monotonic_time();
+
     GstElementPtr pipelinePtr(gst_pipeline_new(nullptr));
     GstElement* pipeline = pipelinePtr.get();
     if(!pipeline) {
@@ -136,164 +269,468 @@ void ReStreamer::start() noexcept
         return;
     }
 
-    GstElementPtr srcPtr(gst_element_factory_make("uridecodebin", nullptr));
-    GstElement* decodebin = srcPtr.get();
-    if(!decodebin) {
-        Log()->error("Failed to create \"uridecodebin\" element");
+    // has to share clock with ingest pipeline
+    g_autoptr(GstClock) clock = gst_system_clock_obtain();
+    gst_pipeline_use_clock(GST_PIPELINE(pipeline), clock);
+
+    GstElementPtr videoSrcPtr(gst_element_factory_make("appsrc", nullptr));
+    GstElement* videoSrc = videoSrcPtr.get();
+    if(!videoSrc) {
+        Log()->error("Failed to create \"appsrc\" element");
+        return;
+    }
+
+    GstElementPtr audioSrcPtr(gst_element_factory_make("appsrc", nullptr));
+    GstElement* audioSrc = audioSrcPtr.get();
+    if(!audioSrc) {
+        Log()->error("Failed to create \"appsrc\" element");
         return;
     }
 
-    _flvMuxPtr.reset(gst_element_factory_make("flvmux", "mux"));
-    GstElement* flvMux = _flvMuxPtr.get();
+    GstElementPtr flvMuxPtr(gst_element_factory_make("flvmux", "mux"));
+    GstElement* flvMux = flvMuxPtr.get();
     if(!flvMux) {
         Log()->error("Failed to create \"flvmux\" element");
         return;
     }
 
-    GstElementPtr rtmpSinkPtr(gst_element_factory_make("rtmpsink", nullptr));
-    GstElement* rtmpSink = rtmpSinkPtr.get();
-    if(!rtmpSink) {
-        Log()->error("Failed to create \"rtmpsink\" element");
+    GstElementPtr appSinkPtr(gst_element_factory_make("appsink", nullptr));
+    GstElement* appSink = appSinkPtr.get();
+    if(!appSink) {
+        Log()->error("Failed to create \"appsink\" element");
         return;
     }
 
 
-    _h264CapsPtr.reset(gst_caps_from_string("video/x-h264"));
-    _audioRawCapsPtr.reset(gst_caps_from_string("audio/x-raw"));
-
-    GstCapsPtr supportedCapsPtr(gst_caps_copy(_h264CapsPtr.get()));
-    gst_caps_append(supportedCapsPtr.get(), gst_caps_copy(_audioRawCapsPtr.get()));
-    GstCaps* supportedCaps = supportedCapsPtr.get();
-
-    g_object_set(decodebin, "caps", supportedCaps, nullptr);
-
-    auto onBusMessageCallback =
-        (gboolean (*) (GstBus*, GstMessage*, gpointer))
-        [] (GstBus* bus, GstMessage* message, gpointer userData) -> gboolean
-    {
-        ReStreamer* self = static_cast<ReStreamer*>(userData);
-        return self->onBusMessage(message);
-    };
-    GstBusPtr busPtr(gst_pipeline_get_bus(GST_PIPELINE(pipeline)));
-    gst_bus_add_watch(busPtr.get(), onBusMessageCallback, this);
+    g_object_set(flvMux, "streamable", true, nullptr);
 
-    auto srcPadAddedCallback =
-        (void (*)(GstElement*, GstPad*, gpointer))
-         [] (GstElement* decodebin, GstPad* pad, gpointer userData)
-    {
-        ReStreamer* self = static_cast<ReStreamer*>(userData);
-        self->srcPadAdded(decodebin, pad);
-    };
-    g_signal_connect(decodebin, "pad-added", G_CALLBACK(srcPadAddedCallback), this);
+    g_object_set(appSink, "sync", FALSE, nullptr);
 
-    auto noMorePadsCallback =
-        (void (*)(GstElement*,  gpointer))
-         [] (GstElement* decodebin, gpointer userData)
+    auto newSampleCallback =
+        (GstFlowReturn (*)(GstAppSink*, gpointer))
+        [] (GstAppSink* appSink, gpointer userData) -> GstFlowReturn
     {
         ReStreamer* self = static_cast<ReStreamer*>(userData);
-        self->noMorePads(decodebin);
+        return self->onMuxedSample(appSink);
     };
-    g_signal_connect(decodebin, "no-more-pads", G_CALLBACK(noMorePadsCallback), this);
-
-    g_object_set(decodebin,
-        "uri", _sourceUrl.c_str(),
-        nullptr);
-
-    _flvVideoSinkPad.reset(gst_element_get_request_pad(_flvMuxPtr.get(), "video"));
-    _flvAudioSinkPad.reset(gst_element_get_request_pad(_flvMuxPtr.get(), "audio"));
-
-    g_object_set(flvMux, "streamable", true, nullptr);
-
-    g_object_set(rtmpSink, "location", _targetUrl.c_str(), nullptr);
-
-    gst_object_ref(flvMux);
+    GstAppSinkCallbacks callbacks {};
+    callbacks.new_sample = newSampleCallback;
+    gst_app_sink_set_callbacks(GST_APP_SINK(appSink), &callbacks, this, nullptr);
+
+    gst_object_ref(videoSrc);
+    gst_object_ref(audioSrc);
+    _videoQueue.setAppSrc(std::move(videoSrcPtr));
+    _audioQueue.setAppSrc(std::move(audioSrcPtr));
     gst_bin_add_many(
         GST_BIN(pipeline),
-        srcPtr.release(), flvMux, rtmpSinkPtr.release(),
+        videoSrc, audioSrc, flvMuxPtr.release(), appSinkPtr.release(),
         nullptr);
     gst_element_link_many(
-        flvMux, rtmpSink,
+        flvMux, appSink,
         nullptr);
 
+    GstPadPtr flvVideoSinkPad(gst_element_get_request_pad(flvMux, "video"));
+    GstPadPtr videoSrcPad(gst_element_get_static_pad(videoSrc, "src"));
+    if(GST_PAD_LINK_OK != gst_pad_link(videoSrcPad.get(), flvVideoSinkPad.get()))
+        assert(false);
+    _muxedVideo.attach(flvVideoSinkPad.get());
+
+    GstPadPtr flvAudioSinkPad(gst_element_get_request_pad(flvMux, "audio"));
+    GstPadPtr audioSrcPad(gst_element_get_static_pad(audioSrc, "src"));
+    if(GST_PAD_LINK_OK != gst_pad_link(audioSrcPad.get(), flvAudioSinkPad.get()))
+        assert(false);
+    _muxedAudio.attach(flvAudioSinkPad.get());
+
     _pipelinePtr = std::move(pipelinePtr);
 
-    play();
+    _busWatch.add(
+        pipeline,
+        _busContext,
+        [this] (GstMessage* message) { return onWorkerBusMessage(message); },
+        [this] (GstMessage* message) { onBusMessage(message); });
+
+    _targetsConnecting.assign(_targets.size(), true);
+    _targetsConnectingCount = _targets.size();
+    for(RTMPTarget& target: _targets)
+        target.start();
+    if(_targets.empty())
+        _onPlaying();
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    _ingest->attach(this);
+
+    // timers run on bus context to keep the main loop free with a lot of reStreamers
+    if(_stallTimeout) {
+        _watchdogTimer.add(
+            _busContext,
+            std::max(_stallTimeout / 4, MinWatchdogInterval),
+            [this] () { checkStall(); });
+    }
+
+    if(_fallbackMode != Config::ReStreamer::Fallback::None) {
+        {
+            std::lock_guard<std::mutex> lock(_timelineMutex);
+            _lastLiveVideoTime = g_get_monotonic_time();
+        }
+
+        _fallbackTimer.add(
+            _busContext,
+            FallbackFrameInterval,
+            [this] () { onFallbackTick(); });
+    }
 }
 
-void ReStreamer::srcPadAdded(
-    GstElement* /*decodebin*/,
-    GstPad* pad)
+void ReStreamer::restartTarget(size_t target) noexcept
 {
-    GstElement* pipeline = _pipelinePtr.get();
+    assert(target < _targets.size());
+    _targets[target].start();
+}
 
-    GstCapsPtr capsPtr(gst_pad_get_current_caps(pad));
-    GstCaps* caps = capsPtr.get();
+GstSample* ReStreamer::slate() noexcept
+{
+    if(_fallbackMode != Config::ReStreamer::Fallback::Slate || _fallbackImage.empty())
+        return nullptr;
+
+    // slate is scaled to the last source video size
+    int width = 0;
+    int height = 0;
+    if(GstCaps* caps = _lastKeyFramePtr ? gst_sample_get_caps(_lastKeyFramePtr.get()) : nullptr) {
+        const GstStructure* structure = gst_caps_get_structure(caps, 0);
+        gst_structure_get_int(structure, "width", &width);
+        gst_structure_get_int(structure, "height", &height);
+    }
 
-    if(gst_caps_is_always_compatible(caps, _h264CapsPtr.get())) {
-        if(_videoLinked) {
-            Log()->error("Multiple video streams not supported");
-            return;
+    if(!_slatePtr || width != _slateWidth || height != _slateHeight) {
+        // previous slate is used until the new one is encoded
+        if(GstSample* slate = SharedSlate(_fallbackImage, width, height)) {
+            _slatePtr.reset(slate);
+            _slateWidth = width;
+            _slateHeight = height;
         }
+    }
 
-        if(GST_PAD_LINK_OK != gst_pad_link(pad, _flvVideoSinkPad.get()))
-            assert(false);
+    return _slatePtr.get();
+}
 
-        _videoLinked = true;
-    } else if(gst_caps_is_always_compatible(caps, _audioRawCapsPtr.get())) {
-        if(_audioLinked) {
-            Log()->error("Multiple audio streams not supported");
-            return;
-        }
+void ReStreamer::onFallbackTick() noexcept
+{
+    std::lock_guard<std::mutex> lock(_timelineMutex);
+
+    if(!_fallback && g_get_monotonic_time() - _lastLiveVideoTime < FallbackDelay * 1000)
+        return;
+
+    GstSample* slate = this->slate();
 
-        GstElementPtr audioResamplePtr(gst_element_factory_make("audioresample", nullptr));
-        GstElement* audioResample = audioResamplePtr.get();
-        if(!audioResample) {
-            Log()->error("Failed to create \"audioresample\" element");
+    if(!_fallback) {
+        // slate falls back to frozen frame until it's encoded or if it failed to encode
+        if(!slate && !_lastKeyFramePtr)
             return;
+
+        Log()->info("No video from source \"{}\". Switching to fallback...", sourceUrl());
+
+        _fallback = true;
+
+        // silence has the same format as source audio
+        gint rate = 0;
+        gint channels = 0;
+        if(_lastAudioCapsPtr) {
+            const GstStructure* structure = gst_caps_get_structure(_lastAudioCapsPtr.get(), 0);
+            gst_structure_get_int(structure, "rate", &rate);
+            gst_structure_get_int(structure, "channels", &channels);
         }
+        _fallbackAudio.setFormat(rate, channels);
+        _fallbackAudio.reset();
+    }
+
+    GstSample* fallbackSample = slate ? slate : _lastKeyFramePtr.get();
+
+    g_autoptr(GstClock) clock = gst_system_clock_obtain();
+    GstClockTime time = gst_clock_get_time(clock) - _sourceGap;
+    if(GST_CLOCK_TIME_IS_VALID(_lastVideoTime) && time <= _lastVideoTime)
+        return;
+
+    // only metadata is copied, memory is shared with encoded frame
+    GstBuffer* buffer = gst_buffer_copy(gst_sample_get_buffer(fallbackSample));
+    GST_BUFFER_PTS(buffer) = time;
+    GST_BUFFER_DTS(buffer) = time;
+    const GstClockTime duration = FallbackFrameInterval * GST_MSECOND;
+    GST_BUFFER_DURATION(buffer) = duration;
+    GST_BUFFER_FLAG_UNSET(buffer, GST_BUFFER_FLAG_DISCONT);
+
+    g_autoptr(GstSample) sample =
+        gst_sample_new(buffer, gst_sample_get_caps(fallbackSample), &_fallbackSegment, nullptr);
+    gst_buffer_unref(buffer);
+
+    // fallback samples are already on output timeline
+    trackVideoCaps(sample, time);
+    _videoQueue.push(sample, 0);
+
+    _lastVideoTime = time;
+    _lastVideoDuration = duration;
+
+    _fallbackAudio.generate(
+        time,
+        &_fallbackSegment,
+        [this] (GstSample* sample) {
+            const GstClockTime time = GST_BUFFER_PTS(gst_sample_get_buffer(sample));
+            if(GST_CLOCK_TIME_IS_VALID(_lastAudioTime) && time <= _lastAudioTime)
+                return;
+
+            _audioQueue.push(sample, 0);
+            _lastAudioTime = time;
+        });
+}
+
+void ReStreamer::checkStall() noexcept
+{
+    const gint64 now = g_get_monotonic_time();
+    const gint64 stallTimeout = static_cast<gint64>(_stallTimeout) * 1000;
+
+    // watchdog is armed by the first sample after (re)connect,
+    // so slow connect is not taken for stall
+    const gint64 lastVideoSampleTime = _lastVideoSampleTime;
+    const gint64 lastAudioSampleTime = _lastAudioSampleTime;
+    const bool videoStalled = lastVideoSampleTime && now - lastVideoSampleTime >= stallTimeout;
+    const bool audioStalled = lastAudioSampleTime && now - lastAudioSampleTime >= stallTimeout;
+    if(!videoStalled && !audioStalled)
+        return;
 
-        gst_bin_add(GST_BIN(pipeline), audioResamplePtr.release());
-        gst_element_sync_state_with_parent(audioResample);
+    ++_stalls;
+
+    Log()->warn(
+        "No {} data from source \"{}\" for {} ms. Reconnecting...",
+        videoStalled ? "video" : "audio",
+        sourceUrl(),
+        (now - (videoStalled ? lastVideoSampleTime : lastAudioSampleTime)) / 1000);
+
+    _lastVideoSampleTime = 0;
+    _lastAudioSampleTime = 0;
+
+    // source is reconnected from the main context
+    GstElement* pipeline = _pipelinePtr.get();
+    GstStructure* structure =
+        gst_structure_new(
+            "stall",
+            "since", G_TYPE_INT64,
+            std::min(
+                lastVideoSampleTime ? lastVideoSampleTime : now,
+                lastAudioSampleTime ? lastAudioSampleTime : now),
+            nullptr);
+    GstBusPtr busPtr(gst_element_get_bus(pipeline));
+    gst_bus_post(busPtr.get(), gst_message_new_application(GST_OBJECT(pipeline), structure));
+}
 
-        GstPadPtr resampleSinkPad(gst_element_get_static_pad(audioResample, "sink"));
-        GstPadPtr resampleSrcPad(gst_element_get_static_pad(audioResample, "src"));
+// called from ingest streaming thread
+void ReStreamer::onSample(
+    Ingest::Stream stream,
+    GstSample* sample,
+    GstClockTime baseTime) noexcept
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    switch(stream) {
+        case Ingest::Stream::Video:
+            _lastVideoSampleTime = g_get_monotonic_time();
+            _lastVideoTimestamp = GST_BUFFER_PTS(buffer);
+            break;
+        case Ingest::Stream::Audio:
+            _lastAudioSampleTime = g_get_monotonic_time();
+            _lastAudioTimestamp = GST_BUFFER_PTS(buffer);
+            break;
+    }
 
-        if(GST_PAD_LINK_OK != gst_pad_link(pad, resampleSinkPad.get()))
-            assert(false);
+    std::lock_guard<std::mutex> lock(_timelineMutex);
 
-        if(GST_PAD_LINK_OK != gst_pad_link(resampleSrcPad.get(), _flvAudioSinkPad.get()))
-            assert(false);
+    if(baseTime != _sourceBaseTime) {
+        if(GST_CLOCK_TIME_IS_VALID(_sourceBaseTime)) {
+            // ingest pipeline was restarted
+            Log()->info("Source \"{}\" reconnected. Resuming reStreaming...", sourceUrl());
+            _videoQueue.resync();
+            _resuming = true;
+        }
+        _sourceBaseTime = baseTime;
+    }
 
-        _audioLinked = true;
-    } else
+    const GstClockTime clockTime = Ingest::SampleClockTime(sample, baseTime);
+    if(!GST_CLOCK_TIME_IS_VALID(clockTime))
         return;
+
+    switch(stream) {
+        case Ingest::Stream::Video: {
+            _lastLiveVideoTime = g_get_monotonic_time();
+
+            const bool keyFrame = IsKeyFrame(buffer);
+
+            if(_resuming || _fallback) {
+                if(!keyFrame)
+                    break;
+
+                if(_fallback)
+                    Log()->info("Switching back to source \"{}\"...", sourceUrl());
+
+                // the first frame after outage goes right after the last one before it
+                if(GST_CLOCK_TIME_IS_VALID(_lastVideoTime)) {
+                    const GstClockTime resumeTime = _lastVideoTime +
+                        (GST_CLOCK_TIME_IS_VALID(_lastVideoDuration) ?
+                            _lastVideoDuration : DefaultFrameDuration);
+                    _sourceGap = GST_CLOCK_DIFF(resumeTime, clockTime);
+                }
+
+                _resuming = false;
+                _fallback = false;
+            }
+
+            if(keyFrame && _fallbackMode != Config::ReStreamer::Fallback::None)
+                _lastKeyFramePtr.reset(gst_sample_ref(sample));
+
+            trackVideoCaps(sample, clockTime - _sourceGap);
+            _videoQueue.push(sample, baseTime - _sourceGap);
+
+            _lastVideoTime = clockTime - _sourceGap;
+            _latency.arrived(_lastVideoTime, Ingest::ArrivalTime(buffer));
+            _lastVideoDuration = GST_BUFFER_DURATION(buffer);
+            break;
+        }
+        case Ingest::Stream::Audio: {
+            GstCaps* caps = gst_sample_get_caps(sample);
+            if(caps && caps != _lastAudioCapsPtr.get())
+                _lastAudioCapsPtr.reset(gst_caps_ref(caps));
+
+            // FLV stream has to start from video keyframe
+            if(_resuming || _fallback || !_videoQueue.isStreaming())
+                break;
+
+            // audio from reconnected source could overlap with already sent one
+            const GstClockTime time = clockTime - _sourceGap;
+            if(GST_CLOCK_TIME_IS_VALID(_lastAudioTime) && time <= _lastAudioTime)
+                break;
+
+            _audioQueue.push(sample, baseTime - _sourceGap);
+
+            _lastAudioTime = time;
+            break;
+        }
+    }
 }
 
+ReStreamer::Stats ReStreamer::stats() const noexcept
+{
+    Stats stats {
+        .videoQueue = _videoQueue.stats(),
+        .audioQueue = _audioQueue.stats(),
+        .targets = {},
+        .startTime = _startTime,
+        .streaming = false,
+        .fallback = false,
+        .muxedVideo = _muxedVideo.stats(),
+        .muxedAudio = _muxedAudio.stats(),
+        .latency = _latency.stats(),
+        .stalls = _stalls,
+        .lastVideoTimestamp = _lastVideoTimestamp,
+        .lastAudioTimestamp = _lastAudioTimestamp,
+    };
+
+    for(const RTMPTarget& target: _targets)
+        stats.targets.push_back(target.stats());
 
-void ReStreamer::noMorePads(GstElement* /*decodebin*/)
+    {
+        std::lock_guard<std::mutex> lock(_timelineMutex);
+        const gint64 lastVideoSampleTime = _lastVideoSampleTime;
+        stats.streaming =
+            _videoQueue.isStreaming() && !_resuming && !_fallback &&
+            lastVideoSampleTime &&
+            g_get_monotonic_time() - lastVideoSampleTime < StreamingTimeout * 1000;
+        stats.fallback = _fallback;
+    }
+
+    return stats;
+}
+
+// has to be called under _timelineMutex
+void ReStreamer::trackVideoCaps(GstSample* sample, GstClockTime outputTime) noexcept
 {
-    if(!_audioLinked) {
-        // stream silence if there is no audio in source.
+    GstCaps* caps = gst_sample_get_caps(sample);
+    if(!caps || caps == _lastVideoCapsPtr.get())
+        return;
 
-        GstElement* pipeline = _pipelinePtr.get();
+    const bool changed = _lastVideoCapsPtr && !SameCodecData(caps, _lastVideoCapsPtr.get());
+    _lastVideoCapsPtr.reset(gst_caps_ref(caps));
 
-        GstElementPtr audioTestSrcPtr(gst_element_factory_make("audiotestsrc", nullptr));
-        GstElement* audioTestSrc = audioTestSrcPtr.get();
-        if(!audioTestSrc) {
-            Log()->error("Failed to create \"audiotestsrc\" element");
-            return;
+    // the first codec data is sent by flvmux itself
+    if(!changed)
+        return;
+
+    std::lock_guard<std::mutex> lock(_videoCapsChangesMutex);
+    _videoCapsChanges.emplace_back(outputTime, GstCapsPtr(gst_caps_ref(caps)));
+    _videoCapsChanged = true;
+}
+
+// called from mux streaming thread for video keyframe tags
+GstSample* ReStreamer::sequenceHeader(GstSample* videoTag, GstClockTime outputTime) noexcept
+{
+    if(_videoCapsChanged.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(_videoCapsChangesMutex);
+        while(!_videoCapsChanges.empty() &&
+            _videoCapsChanges.front().first <= outputTime + CodecChangeTolerance)
+        {
+            _muxedVideoCapsPtr = std::move(_videoCapsChanges.front().second);
+            _videoCapsChanges.pop_front();
         }
+        _videoCapsChanged = !_videoCapsChanges.empty();
+    }
 
-        gst_bin_add(GST_BIN(pipeline), audioTestSrcPtr.release());
-        gst_element_sync_state_with_parent(audioTestSrc);
+    if(!_muxedVideoCapsPtr)
+        return nullptr;
 
-        gst_util_set_object_arg(G_OBJECT(audioTestSrc), "wave", "silence");
+    return SequenceHeaderTag(videoTag, _muxedVideoCapsPtr.get());
+}
 
-        GstPadPtr audioTestSrcPad(gst_element_get_static_pad(audioTestSrc, "src"));
+// called from mux streaming thread
+GstFlowReturn ReStreamer::onMuxedSample(GstAppSink* appSink)
+{
+    g_autoptr(GstSample) sample = gst_app_sink_pull_sample(appSink);
+    if(!sample)
+        return GST_FLOW_OK;
+
+    const GstClockTime baseTime = gst_element_get_base_time(GST_ELEMENT(appSink));
+
+    // flvmux doesn't keep buffers meta,
+    // so arrival time is attached to muxed video frames again
+    g_autoptr(GstSample) trackedSample = nullptr;
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    guint8 tagType;
+    if(buffer &&
+        !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_HEADER) &&
+        gst_buffer_extract(buffer, 0, &tagType, 1) == 1 &&
+        tagType == FlvVideoTag)
+    {
+        const GstClockTime outputTime = Ingest::SampleClockTime(sample, baseTime);
 
-        if(GST_PAD_LINK_OK != gst_pad_link(audioTestSrcPad.get(), _flvAudioSinkPad.get()))
-            assert(false);
+        if(IsKeyFrame(buffer)) {
+            g_autoptr(GstSample) headerSample = sequenceHeader(sample, outputTime);
+            if(headerSample) {
+                for(RTMPTarget& target: _targets)
+                    target.push(headerSample, baseTime);
+            }
+        }
 
-        _audioLinked = true;
+        const GstClockTime arrivalTime = _latency.muxed(outputTime);
+        if(GST_CLOCK_TIME_IS_VALID(arrivalTime)) {
+            // only metadata is copied, memory is shared with muxed buffer
+            g_autoptr(GstBuffer) trackedBuffer = gst_buffer_copy(buffer);
+            Ingest::SetArrivalTime(trackedBuffer, arrivalTime);
+            trackedSample =
+                gst_sample_new(
+                    trackedBuffer,
+                    gst_sample_get_caps(sample),
+                    gst_sample_get_segment(sample),
+                    nullptr);
+        }
     }
+
+    // target failure doesn't affect other targets
+    for(RTMPTarget& target: _targets)
+        target.push(trackedSample ? trackedSample : sample, baseTime);
+
+    return GST_FLOW_OK;
 }
@@ -3,57 +3,152 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include <deque>
+#include <utility>
+#include <mutex>
+#include <atomic>
+
+#include <gst/app/gstappsink.h>
 
 #include <CxxPtr/GstPtr.h>
 
-class ReStreamer
+#include "Config.h"
+#include "BusWatch.h"
+#include "WorkerTimer.h"
+#include "LogRateLimiter.h"
+#include "Ingest.h"
+#include "OutputQueue.h"
+#include "SilentAudio.h"
+#include "TrafficCounter.h"
+#include "LatencyTracker.h"
+#include "RTMPTarget.h"
+
+
+class ReStreamer : private Ingest::Consumer
 {
 public:
+    struct Stats
+    {
+        OutputQueue::Stats videoQueue;
+        OutputQueue::Stats audioQueue;
+        std::deque<RTMPTarget::Stats> targets;
+
+        gint64 startTime; // monotonic time (us)
+        bool streaming; // source video is sent to targets
+        bool fallback; // fallback frames are sent instead of source
+        TrafficCounter::Stats muxedVideo; // data entered FLV muxer
+        TrafficCounter::Stats muxedAudio;
+        LatencyTracker::Stats latency; // from source demuxer to RTMP targets
+
+        unsigned stalls; // times source was reconnected by stall watchdog
+        GstClockTime lastVideoTimestamp; // PTS of the last buffer from source
+        GstClockTime lastAudioTimestamp;
+    };
+
     ReStreamer(
-        const std::string& sourceUrl,
-        const std::string& targetUrl,
+        Ingest* ingest,
+        const Config::ReStreamer&,
+        GMainContext* busContext, // nullptr - default main context
+        const std::function<void (size_t target)>& onTargetPlaying,
+        const std::function<void (size_t target)>& onTargetEos, // target is stopped already
+        const std::function<void ()>& onPlaying, // all targets are playing after start()
         const std::function<void ()>& onEos);
     ~ReStreamer();
 
-    const std::string& sourceUrl() const { return _sourceUrl; };
+    const std::string& sourceUrl() const { return _ingest->sourceUrl(); };
+    size_t targetsCount() const { return _targets.size(); }
+
+    Stats stats() const noexcept;
 
     void start() noexcept;
+    // restarts failed target without affecting the other ones
+    void restartTarget(size_t target) noexcept;
 
 private:
-    void setState(GstState) noexcept;
-    void pause() noexcept;
-    void play() noexcept;
     void stop() noexcept;
 
-    gboolean onBusMessage(GstMessage*);
+    bool onWorkerBusMessage(GstMessage*);
+    void onBusMessage(GstMessage*);
 
-    void unknownType(
-        GstElement* decodebin,
-        GstPad*,
-        GstCaps*);
-    void srcPadAdded(GstElement* decodebin, GstPad*);
-    void noMorePads(GstElement* decodebin);
+    void onSample(
+        Ingest::Stream,
+        GstSample*,
+        GstClockTime baseTime) noexcept override;
 
-    static void postEos(
-        GstElement* rtcbin,
-        gboolean error);
+    // flvmux sends AVC sequence header only once (unless codec is changed),
+    // so it's repeated before keyframes after codec data change (i.e. on switch to/from slate)
+    void trackVideoCaps(GstSample*, GstClockTime outputTime) noexcept; // has to be called under _timelineMutex
+    GstSample* sequenceHeader(GstSample* videoTag, GstClockTime outputTime) noexcept;
+    GstFlowReturn onMuxedSample(GstAppSink*);
 
     void onEos(bool error);
+    void targetConnected(size_t target) noexcept;
+
+    // called on bus worker context
+    void checkStall() noexcept;
+    void onFallbackTick() noexcept;
+    GstSample* slate() noexcept; // has to be called under _timelineMutex
 
 private:
+    std::function<void ()> _onPlaying;
     std::function<void ()> _onEos;
 
-    const std::string _sourceUrl;
-    const std::string _targetUrl;
+    Ingest *const _ingest;
+    GMainContext *const _busContext;
+
+    LatencyTracker _latency; // has to outlive targets
+
+    // FLV stream is muxed once and fanned out to all targets
+    std::deque<RTMPTarget> _targets;
+    std::deque<bool> _targetsConnecting; // since start(), accessed from the main context only
+    size_t _targetsConnectingCount = 0;
 
     GstElementPtr _pipelinePtr;
-    GstElementPtr _flvMuxPtr;
-    GstPadPtr _flvVideoSinkPad;
-    GstPadPtr _flvAudioSinkPad;
+    BusWatch _busWatch;
+    LogRateLimiter _errorLogLimiter;
+
+    const unsigned _stallTimeout; // ms
+    WorkerTimer _watchdogTimer;
+    std::atomic<gint64> _lastVideoSampleTime { 0 }; // monotonic time, 0 - no data since (re)connect
+    std::atomic<gint64> _lastAudioSampleTime { 0 };
+    std::atomic<GstClockTime> _lastVideoTimestamp { GST_CLOCK_TIME_NONE };
+    std::atomic<GstClockTime> _lastAudioTimestamp { GST_CLOCK_TIME_NONE };
+    std::atomic<unsigned> _stalls { 0 };
+
+    OutputQueue _videoQueue;
+    OutputQueue _audioQueue;
+
+    gint64 _startTime = 0;
+    TrafficCounter _muxedVideo;
+    TrafficCounter _muxedAudio;
+
+    // output timeline continues across source reconnects,
+    // i.e. source outages are cut out of it
+    mutable std::mutex _timelineMutex;
+    GstClockTime _sourceBaseTime = GST_CLOCK_TIME_NONE; // identifies ingest pipeline instance
+    GstClockTimeDiff _sourceGap = 0; // total duration of source outages minus fallback time
+    bool _resuming = false; // waiting keyframe from reconnected source
+    GstClockTime _lastVideoTime = GST_CLOCK_TIME_NONE; // clock time on output timeline
+    GstClockTime _lastVideoDuration = GST_CLOCK_TIME_NONE;
+    GstClockTime _lastAudioTime = GST_CLOCK_TIME_NONE; // clock time on output timeline
+    GstCapsPtr _lastVideoCapsPtr; // accessed under _timelineMutex
 
-    GstCapsPtr _h264CapsPtr;
-    GstCapsPtr _audioRawCapsPtr;
+    std::mutex _videoCapsChangesMutex;
+    std::deque<std::pair<GstClockTime, GstCapsPtr>> _videoCapsChanges; // output time, caps with new codec data
+    std::atomic<bool> _videoCapsChanged { false };
+    GstCapsPtr _muxedVideoCapsPtr; // accessed from mux streaming thread only
 
-    bool _videoLinked = false;
-    bool _audioLinked = false;
+    // fallback output while source is down
+    const Config::ReStreamer::Fallback _fallbackMode;
+    const std::string _fallbackImage;
+    WorkerTimer _fallbackTimer;
+    GstSamplePtr _slatePtr; // shared slate of source video size, accessed under _timelineMutex
+    int _slateWidth = 0;
+    int _slateHeight = 0;
+    GstSamplePtr _lastKeyFramePtr; // accessed under _timelineMutex
+    GstCapsPtr _lastAudioCapsPtr; // accessed under _timelineMutex
+    gint64 _lastLiveVideoTime = 0; // monotonic time, accessed under _timelineMutex
+    bool _fallback = false; // accessed under _timelineMutex
+    GstSegment _fallbackSegment;
+    SilentAudio _fallbackAudio;
 };
@@ -1,11 +1,22 @@
 #include "RestApi.h"
 
 #include <cassert>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <deque>
+#include <cstring>
+#include <string>
+#include <chrono>
 
 #include <glib.h>
 #include <jansson.h>
 #include <microhttpd.h>
 
+#include "Log.h"
+#include "ConfigLoader.h"
+#include "StreamerIndex.h"
+
 
 const char *const rest::ApiPrefix = "/api";
 
@@ -20,7 +31,23 @@ const size_t ApiPrefixLen = strlen(rest::ApiPrefix);
 const char *const StreamersPrefix = "/streamers";
 const size_t StreamersPrefixLen = strlen(StreamersPrefix);
 
+const char *const MetricsPrefix = "/metrics";
+const size_t MetricsPrefixLen = strlen(MetricsPrefix);
+
+const char *const EventsPrefix = "/events";
+const size_t EventsPrefixLen = strlen(EventsPrefix);
+
+const size_t EventsBlockSize = 4 * 1024;
+// comment line is sent without events to detect closed connection
+const std::chrono::milliseconds EventsKeepAliveInterval = std::chrono::seconds(15);
+
 const char* const CONTENT_TYPE_APPLICATION_JSON = "application/json";
+const char* const CONTENT_TYPE_PROMETHEUS_TEXT = "text/plain; version=0.0.4; charset=utf-8";
+const char* const CONTENT_TYPE_EVENT_STREAM = "text/event-stream";
+
+// HTTP server doesn't pass request headers to handler,
+// so If-None-Match value is accepted as query parameter
+const char* const IfNoneMatchParam = "if-none-match";
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(json_t, json_decref)
 typedef char* json_char_ptr;
@@ -33,13 +60,55 @@ inline char* json_dumps(json_t* json)
 }
 
 inline std::pair<rest::StatusCode, MHD_Response*>
-ApplyDefaultHeaders(std::pair<rest::StatusCode, MHD_Response*>&& response)
+ApplyDefaultHeaders(
+    std::pair<rest::StatusCode, MHD_Response*>&& response,
+    const char* cacheControl = "no-store")
 {
     if(response.second) {
         MHD_add_response_header(
             response.second,
             MHD_HTTP_HEADER_CONTENT_TYPE,
             CONTENT_TYPE_APPLICATION_JSON);
+        MHD_add_response_header(
+            response.second,
+            MHD_HTTP_HEADER_CACHE_CONTROL,
+            cacheControl);
+#ifndef NDEBUG
+        MHD_add_response_header(
+            response.second,
+            MHD_HTTP_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN,
+            "*"); // FIXME?
+#endif
+    }
+
+    return response;
+}
+
+inline std::pair<rest::StatusCode, MHD_Response*>
+ApplyMetricsHeaders(std::pair<rest::StatusCode, MHD_Response*>&& response)
+{
+    if(response.second) {
+        MHD_add_response_header(
+            response.second,
+            MHD_HTTP_HEADER_CONTENT_TYPE,
+            CONTENT_TYPE_PROMETHEUS_TEXT);
+        MHD_add_response_header(
+            response.second,
+            MHD_HTTP_HEADER_CACHE_CONTROL,
+            "no-store");
+    }
+
+    return response;
+}
+
+inline std::pair<rest::StatusCode, MHD_Response*>
+ApplyEventsHeaders(std::pair<rest::StatusCode, MHD_Response*>&& response)
+{
+    if(response.second) {
+        MHD_add_response_header(
+            response.second,
+            MHD_HTTP_HEADER_CONTENT_TYPE,
+            CONTENT_TYPE_EVENT_STREAM);
         MHD_add_response_header(
             response.second,
             MHD_HTTP_HEADER_CACHE_CONTROL,
@@ -108,13 +177,153 @@ NotFound(MHD_Response* response = nullptr)
     return { MHD_HTTP_NOT_FOUND, FixResponse(response) };
 }
 
-std::pair<rest::StatusCode, MHD_Response*>
-HandleStreamersRequest(
-    const std::shared_ptr<const Config>& config,
-    const char* path)
+inline std::pair<rest::StatusCode, MHD_Response*>
+NotModified(MHD_Response* response = nullptr)
 {
-    if(strcmp(path, "") != STRCMP_EQUAL && strcmp(path, "/") != STRCMP_EQUAL)
-        return BadRequest();
+    return { MHD_HTTP_NOT_MODIFIED, FixResponse(response) };
+}
+
+// accepts array of not empty strings.
+// returns false on wrong format
+bool ParseStringList(json_t* object, const char* name, std::deque<std::string>* out)
+{
+    json_t* array = json_object_get(object, name);
+    if(!array)
+        return true;
+
+    if(!json_is_array(array))
+        return false;
+
+    size_t index;
+    json_t* value;
+    json_array_foreach(array, index, value) {
+        if(!json_is_string(value) || json_string_length(value) == 0)
+            return false;
+
+        out->emplace_back(json_string_value(value));
+    }
+
+    return true;
+}
+
+// "target", "key", "keys" and "targets" are completed to target urls
+// the same way as in config file.
+// returns false on wrong format or if target urls can't be completed
+bool ParseTargetUrls(const Config& config, json_t* object, std::optional<std::deque<std::string>>* out)
+{
+    json_t* target = json_object_get(object, "target");
+    json_t* key = json_object_get(object, "key");
+    if(!target && !key && !json_object_get(object, "keys") && !json_object_get(object, "targets"))
+        return true;
+
+    if(target && (!json_is_string(target) || json_string_length(target) == 0))
+        return false;
+
+    std::deque<std::string> keys;
+    if(key) {
+        if(!json_is_string(key) || json_string_length(key) == 0)
+            return false;
+
+        keys.emplace_back(json_string_value(key));
+    }
+
+    std::deque<std::string> targets;
+    if(!ParseStringList(object, "keys", &keys) || !ParseStringList(object, "targets", &targets))
+        return false;
+
+    std::deque<std::string> targetUrls;
+    if(BuildTargetUrls(config, target ? json_string_value(target) : nullptr, keys, targets, &targetUrls))
+        return false;
+
+    if(targetUrls.empty())
+        return false;
+
+    *out = std::move(targetUrls);
+
+    return true;
+}
+
+// returns false on wrong format
+bool ParseString(json_t* object, const char* name, bool allowEmpty, std::optional<std::string>* out)
+{
+    json_t* value = json_object_get(object, name);
+    if(!value)
+        return true;
+
+    if(!json_is_string(value) || (!allowEmpty && json_string_length(value) == 0))
+        return false;
+
+    *out = json_string_value(value);
+
+    return true;
+}
+
+// serialized GET /api/streamers response for specific config version.
+// It has config state only, so it's not changed with every stats tick:
+// runtime state is served by /api/metrics and /api/events
+struct StreamersBody
+{
+    std::string etag;
+    std::string json;
+};
+
+// shared by all HTTP threads, accessed with std::atomic_* only
+std::shared_ptr<const StreamersBody> CachedStreamersBody;
+
+std::string StreamersETag(guint64 configVersion)
+{
+    g_autofree gchar* etag = g_strdup_printf("\"%" G_GUINT64_FORMAT "\"", configVersion);
+    return etag;
+}
+
+// strong comparison (RFC 9110, 8.8.3.2): both entity tags are not weak and equal
+bool ETagsStrongEqual(const std::string& l, const std::string& r)
+{
+    return !g_str_has_prefix(l.c_str(), "W/") && !g_str_has_prefix(r.c_str(), "W/") && l == r;
+}
+
+// If-None-Match uses weak comparison (RFC 9110, 13.1.2):
+// opaque tags are compared ignoring weakness indicator
+bool IfNoneMatch(const char* ifNoneMatch, const std::string& etag)
+{
+    const char* opaqueTag = etag.c_str();
+    if(g_str_has_prefix(opaqueTag, "W/"))
+        opaqueTag += 2;
+    const size_t opaqueTagLen = strlen(opaqueTag);
+
+    const char* position = ifNoneMatch;
+    for(;;) {
+        while(*position == ' ' || *position == '\t' || *position == ',')
+            ++position;
+
+        if(*position == '\0')
+            return false;
+
+        if(*position == '*')
+            return true;
+
+        if(g_str_has_prefix(position, "W/"))
+            position += 2;
+
+        if(*position != '"')
+            return false; // malformed
+
+        const char* tagEnd = strchr(position + 1, '"');
+        if(!tagEnd)
+            return false; // malformed
+
+        const size_t tagLen = tagEnd + 1 - position;
+        if(tagLen == opaqueTagLen && strncmp(position, opaqueTag, tagLen) == STRCMP_EQUAL)
+            return true;
+
+        position = tagEnd + 1;
+    }
+}
+
+std::shared_ptr<const StreamersBody>
+BuildStreamersBody(const std::shared_ptr<const ConfigSnapshot>& configSnapshot)
+{
+    const Config* config = &configSnapshot->config;
 
     g_autoptr(json_t) array = json_array();
 
@@ -134,57 +343,575 @@ HandleStreamersRequest(
         object = nullptr;
     }
 
-    g_auto(json_char_ptr) json = json_dumps(array);
+    // compact since it's for machines polling it
+    g_auto(json_char_ptr) json = ::json_dumps(array, JSON_COMPACT);
     if(!json)
-        return InternalError();
+        return nullptr;
+
+    return
+        std::make_shared<const StreamersBody>(
+            StreamersBody {
+                .etag = StreamersETag(configSnapshot->version),
+                .json = json,
+            });
+}
+
+std::pair<rest::StatusCode, MHD_Response*>
+HandleStreamersRequest(
+    const std::shared_ptr<const ConfigSnapshot>& configSnapshot,
+    const char* path,
+    const char* query)
+{
+    if(strcmp(path, "") != STRCMP_EQUAL && strcmp(path, "/") != STRCMP_EQUAL)
+        return BadRequest();
+
+    const std::string etag = StreamersETag(configSnapshot->version);
+
+    if(query) {
+        g_autoptr(GHashTable) params = g_uri_parse_params(query, -1, "&", G_URI_PARAMS_NONE, nullptr);
+        if(!params)
+            return BadRequest();
+
+        const char* ifNoneMatch = static_cast<const char*>(g_hash_table_lookup(params, IfNoneMatchParam));
+        if(ifNoneMatch && IfNoneMatch(ifNoneMatch, etag)) {
+            std::pair<rest::StatusCode, MHD_Response*> response = NotModified();
+            MHD_add_response_header(response.second, MHD_HTTP_HEADER_ETAG, etag.c_str());
+            return response;
+        }
+    }
+
+    std::shared_ptr<const StreamersBody> body = std::atomic_load(&CachedStreamersBody);
+    if(!body || !ETagsStrongEqual(body->etag, etag)) {
+        // concurrent requests could build the same body, the last one is kept
+        body = BuildStreamersBody(configSnapshot);
+        if(!body)
+            return InternalError();
+
+        std::atomic_store(&CachedStreamersBody, body);
+    }
 
     MHD_Response* response = MHD_create_response_from_buffer(
-        strlen(json),
-        json,
-        MHD_RESPMEM_MUST_FREE);
+        body->json.size(),
+        const_cast<char*>(body->json.data()),
+        MHD_RESPMEM_MUST_COPY);
     if(!response)
         return InternalError();
 
-    json = nullptr; // to avoid double free
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, body->etag.c_str());
+
+    return OK(response);
+}
+
+// state of single events subscriber
+struct EventsReader
+{
+    std::shared_ptr<StreamerEvents> events;
+    guint64 cursor = 0;
+    std::string pending;
+    size_t pendingOffset = 0;
+};
+
+// called from HTTP connection thread,
+// blocks until the next events are available,
+// so it relies on thread per connection mode of HTTP server
+ssize_t ReadEvents(void* cls, uint64_t /*pos*/, char* buffer, size_t max)
+{
+    EventsReader* reader = static_cast<EventsReader*>(cls);
+
+    if(reader->pendingOffset >= reader->pending.size()) {
+        reader->pending = reader->events->next(&reader->cursor, EventsKeepAliveInterval);
+        reader->pendingOffset = 0;
+        if(reader->pending.empty())
+            reader->pending = ":\n\n";
+    }
+
+    const size_t size = std::min(max, reader->pending.size() - reader->pendingOffset);
+    memcpy(buffer, reader->pending.data() + reader->pendingOffset, size);
+    reader->pendingOffset += size;
+
+    return size;
+}
+
+std::pair<rest::StatusCode, MHD_Response*>
+HandleEventsRequest(
+    const std::shared_ptr<StreamerEvents>& events,
+    const char* path)
+{
+    if(strcmp(path, "") != STRCMP_EQUAL && strcmp(path, "/") != STRCMP_EQUAL)
+        return BadRequest();
+
+    EventsReader* reader = new EventsReader { .events = events };
+
+    MHD_Response* response = MHD_create_response_from_callback(
+        MHD_SIZE_UNKNOWN,
+        EventsBlockSize,
+        ReadEvents,
+        reader,
+        [] (void* cls) {
+            EventsReader* reader = static_cast<EventsReader*>(cls);
+            reader->events->unsubscribe();
+            delete reader;
+        });
+    if(!response) {
+        delete reader;
+        return InternalError();
+    }
+
+    events->subscribe();
 
     return OK(response);
 }
 
+// label values are escaped according to Prometheus text exposition format
+std::string EscapeLabelValue(const std::string& value)
+{
+    std::string escaped;
+    escaped.reserve(value.size());
+    for(char c: value) {
+        switch(c) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                escaped += c;
+                break;
+        }
+    }
+
+    return escaped;
+}
+
+void AppendMetricHeader(GString* out, const char* name, const char* type, const char* help)
+{
+    g_string_append_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void AppendMetric(GString* out, const char* name, const std::string& labels, guint64 value)
+{
+    g_string_append_printf(out, "%s{%s} %" G_GUINT64_FORMAT "\n", name, labels.c_str(), value);
+}
+
+void AppendMetric(GString* out, const char* name, const std::string& labels, double value)
+{
+    gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+    g_string_append_printf(
+        out,
+        "%s{%s} %s\n",
+        name,
+        labels.c_str(),
+        g_ascii_dtostr(buffer, sizeof(buffer), value));
+}
+
+void ForEachQueue(
+    const std::string& labels,
+    const ReStreamer::Stats& stats,
+    const std::function<void (const std::string& labels, const OutputQueue::Stats&)>& callback)
+{
+    callback(labels + ",queue=\"video\"", stats.videoQueue);
+    callback(labels + ",queue=\"audio\"", stats.audioQueue);
+    for(size_t i = 0; i < stats.targets.size(); ++i)
+        callback(labels + ",queue=\"target\",target=\"" + std::to_string(i) + "\"", stats.targets[i].queue);
+}
+
+std::pair<rest::StatusCode, MHD_Response*>
+HandleMetricsRequest(
+    const std::shared_ptr<const Config>& config,
+    const std::shared_ptr<const StatsSnapshot>& statsSnapshot,
+    const char* path)
+{
+    if(strcmp(path, "") != STRCMP_EQUAL && strcmp(path, "/") != STRCMP_EQUAL)
+        return BadRequest();
+
+    const std::map<std::string, RestartScheduler::State>& restartStates = statsSnapshot->restartStates;
+    const std::map<std::string, ReStreamer::Stats>& stats = statsSnapshot->reStreamers;
+    const gint64 now = g_get_monotonic_time();
+
+    // text exposition format requires all samples of metric family to be grouped together,
+    // so every family is written for all reStreamers at once
+    struct Family
+    {
+        const char* name;
+        const char* type;
+        const char* help;
+        std::function<void (GString*, const std::string& labels, const std::string& id)> append;
+    };
+
+    auto appendIfRunning =
+        [&stats] (auto&& append) {
+            return
+                [&stats, append] (GString* out, const std::string& labels, const std::string& id) {
+                    const auto it = stats.find(id);
+                    if(it != stats.end())
+                        append(out, labels, it->second);
+                };
+        };
+
+    const Family families[] = {
+        { "restreamer_enabled", "gauge", "Whether reStreamer is enabled in config",
+            [&config] (GString* out, const std::string& labels, const std::string& id) {
+                AppendMetric(out, "restreamer_enabled", labels, guint64(config->reStreamers.at(id).enabled));
+            } },
+        { "restreamer_up", "gauge", "Whether reStreamer pipeline is running",
+            [&stats] (GString* out, const std::string& labels, const std::string& id) {
+                AppendMetric(out, "restreamer_up", labels, guint64(stats.count(id)));
+            } },
+        { "restreamer_restarts_total", "counter", "ReStreamer starts except the first one",
+            [&restartStates] (GString* out, const std::string& labels, const std::string& id) {
+                const auto it = restartStates.find(id);
+                AppendMetric(
+                    out,
+                    "restreamer_restarts_total",
+                    labels,
+                    guint64(it != restartStates.end() ? it->second.restarts : 0));
+            } },
+        { "restreamer_restart_failures", "gauge", "Consecutive reStreamer failures since last stable run",
+            [&restartStates] (GString* out, const std::string& labels, const std::string& id) {
+                const auto it = restartStates.find(id);
+                AppendMetric(
+                    out,
+                    "restreamer_restart_failures",
+                    labels,
+                    guint64(it != restartStates.end() ? it->second.failures : 0));
+            } },
+        { "restreamer_source_restarts_total", "counter", "Source reconnects after failures",
+            [&config, &restartStates] (GString* out, const std::string& labels, const std::string& id) {
+                const auto it =
+                    restartStates.find(RestartScheduler::SourceId(config->reStreamers.at(id).sourceUrl));
+                AppendMetric(
+                    out,
+                    "restreamer_source_restarts_total",
+                    labels,
+                    guint64(it != restartStates.end() ? it->second.restarts : 0));
+            } },
+        { "restreamer_uptime_seconds", "gauge", "Time since reStreamer start",
+            appendIfRunning([now] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                AppendMetric(out, "restreamer_uptime_seconds", labels, double(now - stats.startTime) / G_USEC_PER_SEC);
+            }) },
+        { "restreamer_fallback", "gauge", "Whether fallback frames are sent instead of source",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                AppendMetric(out, "restreamer_fallback", labels, guint64(stats.fallback));
+            }) },
+        { "restreamer_stalls_total", "counter", "Source reconnects initiated by stall watchdog",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                AppendMetric(out, "restreamer_stalls_total", labels, guint64(stats.stalls));
+            }) },
+        { "restreamer_video_frames_total", "counter", "Video frames muxed to FLV",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                AppendMetric(out, "restreamer_video_frames_total", labels, stats.muxedVideo.buffers);
+            }) },
+        { "restreamer_video_bytes_total", "counter", "Video bytes muxed to FLV",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                AppendMetric(out, "restreamer_video_bytes_total", labels, stats.muxedVideo.bytes);
+            }) },
+        { "restreamer_audio_frames_total", "counter", "Audio frames muxed to FLV",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                AppendMetric(out, "restreamer_audio_frames_total", labels, stats.muxedAudio.buffers);
+            }) },
+        { "restreamer_audio_bytes_total", "counter", "Audio bytes muxed to FLV",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                AppendMetric(out, "restreamer_audio_bytes_total", labels, stats.muxedAudio.bytes);
+            }) },
+        { "restreamer_latency_seconds", "histogram", "Video frames latency from source demuxer to RTMP targets",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                const LatencyTracker::Stats& latency = stats.latency;
+                gchar bound[G_ASCII_DTOSTR_BUF_SIZE];
+                guint64 cumulative = 0;
+                for(size_t i = 0; i < LatencyTracker::BucketBounds.size(); ++i) {
+                    cumulative += latency.buckets[i];
+                    g_ascii_dtostr(bound, sizeof(bound), double(LatencyTracker::BucketBounds[i]) / GST_SECOND);
+                    AppendMetric(
+                        out,
+                        "restreamer_latency_seconds_bucket",
+                        labels + ",le=\"" + bound + "\"",
+                        cumulative);
+                }
+                // buckets are updated independently, so count is taken from them to stay consistent
+                cumulative += latency.buckets.back();
+                AppendMetric(out, "restreamer_latency_seconds_bucket", labels + ",le=\"+Inf\"", cumulative);
+                AppendMetric(out, "restreamer_latency_seconds_sum", labels, double(latency.sum) / GST_SECOND);
+                AppendMetric(out, "restreamer_latency_seconds_count", labels, cumulative);
+            }) },
+        { "restreamer_target_up", "gauge", "Whether RTMP target pipeline is playing",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                for(size_t i = 0; i < stats.targets.size(); ++i) {
+                    AppendMetric(
+                        out,
+                        "restreamer_target_up",
+                        labels + ",target=\"" + std::to_string(i) + "\"",
+                        guint64(stats.targets[i].playing));
+                }
+            }) },
+        { "restreamer_target_restarts_total", "counter", "RTMP target restarts after failures",
+            [&restartStates, &stats] (GString* out, const std::string& labels, const std::string& id) {
+                const auto statsIt = stats.find(id);
+                if(statsIt == stats.end())
+                    return;
+
+                for(size_t i = 0; i < statsIt->second.targets.size(); ++i) {
+                    const auto it = restartStates.find(RestartScheduler::TargetId(id, i));
+                    AppendMetric(
+                        out,
+                        "restreamer_target_restarts_total",
+                        labels + ",target=\"" + std::to_string(i) + "\"",
+                        guint64(it != restartStates.end() ? it->second.restarts : 0));
+                }
+            } },
+        { "restreamer_target_sent_bytes_total", "counter", "FLV bytes sent to RTMP target",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                for(size_t i = 0; i < stats.targets.size(); ++i) {
+                    AppendMetric(
+                        out,
+                        "restreamer_target_sent_bytes_total",
+                        labels + ",target=\"" + std::to_string(i) + "\"",
+                        stats.targets[i].sentBytes);
+                }
+            }) },
+        { "restreamer_queue_bytes", "gauge", "Bytes queued for output",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                ForEachQueue(labels, stats,
+                    [out] (const std::string& labels, const OutputQueue::Stats& queue) {
+                        AppendMetric(out, "restreamer_queue_bytes", labels, queue.bytes);
+                    });
+            }) },
+        { "restreamer_queue_seconds", "gauge", "Duration of data queued for output",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                ForEachQueue(labels, stats,
+                    [out] (const std::string& labels, const OutputQueue::Stats& queue) {
+                        AppendMetric(
+                            out,
+                            "restreamer_queue_seconds",
+                            labels,
+                            GST_CLOCK_TIME_IS_VALID(queue.time) ? double(queue.time) / GST_SECOND : 0.);
+                    });
+            }) },
+        { "restreamer_queue_dropped_buffers_total", "counter", "Buffers dropped by output queue",
+            appendIfRunning([] (GString* out, const std::string& labels, const ReStreamer::Stats& stats) {
+                ForEachQueue(labels, stats,
+                    [out] (const std::string& labels, const OutputQueue::Stats& queue) {
+                        AppendMetric(out, "restreamer_queue_dropped_buffers_total", labels, queue.droppedBuffers);
+                    });
+            }) },
+    };
+
+    g_autoptr(GString) out = g_string_new(nullptr);
+
+    const ReStreamerLogStats logStats = ReStreamerLogStatistics();
+    AppendMetricHeader(
+        out,
+        "restreamer_log_dropped_messages_total",
+        "counter",
+        "Log messages dropped on log queue overflow");
+    AppendMetric(out, "restreamer_log_dropped_messages_total", std::string(), guint64(logStats.dropped));
+    AppendMetricHeader(
+        out,
+        "restreamer_log_suppressed_messages_total",
+        "counter",
+        "Log messages suppressed by rate limiting");
+    AppendMetric(out, "restreamer_log_suppressed_messages_total", std::string(), guint64(logStats.suppressed));
+
+    AppendMetricHeader(
+        out,
+        "restreamer_startup_seconds",
+        "gauge",
+        "Time from startup till all enabled reStreamers were streaming");
+    if(statsSnapshot->startupDuration >= 0) {
+        AppendMetric(
+            out,
+            "restreamer_startup_seconds",
+            std::string(),
+            double(statsSnapshot->startupDuration) / G_USEC_PER_SEC);
+    }
+
+    for(const Family& family: families) {
+        AppendMetricHeader(out, family.name, family.type, family.help);
+        for(const std::string& reStreamerId: config->reStreamersOrder) {
+            if(config->reStreamers.find(reStreamerId) == config->reStreamers.end())
+                continue;
+
+            family.append(out, "id=\"" + EscapeLabelValue(reStreamerId) + "\"", reStreamerId);
+        }
+    }
+
+    MHD_Response* response = MHD_create_response_from_buffer(
+        out->len,
+        out->str,
+        MHD_RESPMEM_MUST_COPY);
+    if(!response)
+        return InternalError();
+
+    return OK(response);
+}
+
+// changes of existing reStreamer.
+// returns MHD_HTTP_OK on success
+rest::StatusCode ParseStreamerChanges(
+    const ConfigSnapshot& snapshot,
+    const std::string& id,
+    json_t* object,
+    ConfigChanges::ReStreamerChanges* reStreamerChanges)
+{
+    const Config& config = snapshot.config;
+    const auto reStreamerIt = config.reStreamers.find(id);
+    if(reStreamerIt == config.reStreamers.end())
+        return MHD_HTTP_NOT_FOUND;
+
+    if(!json_is_object(object))
+        return MHD_HTTP_BAD_REQUEST;
+
+    bool hasChanges = false;
+    if(json_t* enable = json_object_get(object, "enable")) {
+        if(!json_is_boolean(enable))
+            return MHD_HTTP_BAD_REQUEST;
+
+        hasChanges = true;
+        reStreamerChanges->enabled = json_is_true(enable);
+    }
+
+    if(!ParseString(object, "source", false, &reStreamerChanges->sourceUrl))
+        return MHD_HTTP_BAD_REQUEST;
+    if(!ParseString(object, "description", true, &reStreamerChanges->description))
+        return MHD_HTTP_BAD_REQUEST;
+    if(!ParseTargetUrls(config, object, &reStreamerChanges->targetUrls))
+        return MHD_HTTP_BAD_REQUEST;
+
+    if(reStreamerChanges->sourceUrl || reStreamerChanges->targetUrls) {
+        const Config::ReStreamer& reStreamer = reStreamerIt->second;
+        const std::string* sameId = snapshot.index.find(
+            reStreamerChanges->sourceUrl ? *reStreamerChanges->sourceUrl : reStreamer.sourceUrl,
+            reStreamerChanges->targetUrls ? *reStreamerChanges->targetUrls : reStreamer.targetUrls);
+        if(sameId && *sameId != id)
+            return MHD_HTTP_CONFLICT;
+    }
+
+    hasChanges = hasChanges ||
+        reStreamerChanges->sourceUrl ||
+        reStreamerChanges->description ||
+        reStreamerChanges->targetUrls;
+
+    if(!hasChanges)
+        return MHD_HTTP_BAD_REQUEST;
+
+    return MHD_HTTP_OK;
+}
+
+// new reStreamer, source and targets are required.
+// returns MHD_HTTP_OK on success
+rest::StatusCode ParseAddedStreamer(
+    const ConfigSnapshot& snapshot,
+    json_t* object,
+    ConfigChanges::ReStreamerChanges* reStreamerChanges)
+{
+    if(!json_is_object(object))
+        return MHD_HTTP_BAD_REQUEST;
+
+    std::optional<std::string> sourceUrl;
+    std::optional<std::string> description;
+    std::optional<std::deque<std::string>> targetUrls;
+    if(!ParseString(object, "source", false, &sourceUrl) ||
+        !ParseString(object, "description", true, &description) ||
+        !ParseTargetUrls(snapshot.config, object, &targetUrls))
+    {
+        return MHD_HTTP_BAD_REQUEST;
+    }
+
+    if(!sourceUrl || !targetUrls)
+        return MHD_HTTP_BAD_REQUEST;
+
+    bool enabled = true;
+    if(json_t* enable = json_object_get(object, "enable")) {
+        if(!json_is_boolean(enable))
+            return MHD_HTTP_BAD_REQUEST;
+
+        enabled = json_is_true(enable);
+    }
+
+    // reStreamer added by not yet applied request is rejected by the main loop
+    if(snapshot.index.find(*sourceUrl, *targetUrls))
+        return MHD_HTTP_CONFLICT;
+
+    reStreamerChanges->added =
+        Config::ReStreamer {
+            *sourceUrl,
+            description.value_or(std::string()),
+            *targetUrls,
+            enabled };
+
+    return MHD_HTTP_OK;
+}
+
 std::pair<rest::StatusCode, MHD_Response*>
 HandleStreamerPatch(
-    const std::shared_ptr<Config>& streamersConfig,
+    const std::shared_ptr<const ConfigSnapshot>& snapshot,
     const rest::PostConfigChanges& postChanges,
     const char* path,
     const std::string_view& body)
 {
-    const char* id = path;
+    const std::string id = path;
 
-    auto it = streamersConfig->reStreamers.find(id);
-    if(it == streamersConfig->reStreamers.end())
-        return NotFound();
+    g_autoptr(json_t) requestBody = json_loadb(body.data(), body.size(), 0, nullptr);
+    if(!requestBody)
+        return BadRequest();
+
+    std::unique_ptr<ConfigChanges> changes = std::make_unique<ConfigChanges>();
+    const rest::StatusCode status =
+        ParseStreamerChanges(*snapshot, id, requestBody, &changes->reStreamersChanges[id]);
+    if(status != MHD_HTTP_OK)
+        return { status, FixResponse(nullptr) };
+
+    postChanges(std::move(changes));
 
-    Config::ReStreamer& reStreamerConfig = it->second;
+    return OK();
+}
 
+// JSON merge patch (RFC 7396) of streamers collection keyed by id:
+// null removes reStreamer, object adds new or changes existing one
+std::pair<rest::StatusCode, MHD_Response*>
+HandleStreamersMergePatch(
+    const std::shared_ptr<const ConfigSnapshot>& snapshot,
+    const rest::PostConfigChanges& postChanges,
+    const std::string_view& body)
+{
     g_autoptr(json_t) requestBody = json_loadb(body.data(), body.size(), 0, nullptr);
-    if(!requestBody || !json_is_object(requestBody))
+    if(!requestBody || !json_is_object(requestBody) || json_object_size(requestBody) == 0)
         return BadRequest();
 
-    std::unique_ptr<ConfigChanges> changes =  std::make_unique<ConfigChanges>();
-    ConfigChanges::ReStreamerChanges& reStreamerChanges =
-        changes->reStreamersChanges.emplace(id, ConfigChanges::ReStreamerChanges()).first->second;
+    const Config& config = snapshot->config;
 
-    bool hasChanges = false;
-    if(json_t* enable = json_object_get(requestBody, "enable")) {
-        if(!json_is_boolean(enable))
+    std::unique_ptr<ConfigChanges> changes = std::make_unique<ConfigChanges>();
+    StreamerIndex addedIndex; // to reject duplicates inside request
+    const char* key;
+    json_t* value;
+    json_object_foreach(requestBody, key, value) {
+        const std::string id = key;
+        if(id.empty())
             return BadRequest();
 
-        hasChanges = true;
-        reStreamerConfig.enabled = json_is_true(enable);
-        reStreamerChanges.enabled = reStreamerConfig.enabled;
-    }
+        ConfigChanges::ReStreamerChanges& reStreamerChanges = changes->reStreamersChanges[id];
+        const bool exists = config.reStreamers.find(id) != config.reStreamers.end();
 
-    if(!hasChanges) {
-        return BadRequest();
+        rest::StatusCode status;
+        if(json_is_null(value)) {
+            status = exists ? MHD_HTTP_OK : MHD_HTTP_NOT_FOUND;
+            reStreamerChanges.removed = true;
+        } else if(exists) {
+            status = ParseStreamerChanges(*snapshot, id, value, &reStreamerChanges);
+        } else {
+            status = ParseAddedStreamer(*snapshot, value, &reStreamerChanges);
+            if(status == MHD_HTTP_OK) {
+                const Config::ReStreamer& added = *reStreamerChanges.added;
+                if(!addedIndex.insert(added.sourceUrl, added.targetUrls, id))
+                    status = MHD_HTTP_CONFLICT;
+            }
+        }
+
+        if(status != MHD_HTTP_OK)
+            return { status, FixResponse(nullptr) };
     }
 
     postChanges(std::move(changes));
@@ -194,20 +921,19 @@ HandleStreamerPatch(
 
 std::pair<rest::StatusCode, MHD_Response*>
 HandleStreamersPatch(
-    const std::shared_ptr<Config>& streamersConfig,
+    const std::shared_ptr<const ConfigSnapshot>& snapshot,
     const rest::PostConfigChanges& postChanges,
     const char* path,
     const std::string_view& body)
 {
-    if(strcmp(path, "") == STRCMP_EQUAL ||
-        strcmp(path, "/") == STRCMP_EQUAL ||
-        !g_str_has_prefix(path, "/"))
-    {
-        return BadRequest(); // only PATCH for specific streamer is supported ATM
-    }
+    if(strcmp(path, "") == STRCMP_EQUAL || strcmp(path, "/") == STRCMP_EQUAL)
+        return HandleStreamersMergePatch(snapshot, postChanges, body);
+
+    if(!g_str_has_prefix(path, "/"))
+        return BadRequest();
 
     ++path; // to skip '/'
-    return HandleStreamerPatch(streamersConfig, postChanges, path, body);
+    return HandleStreamerPatch(snapshot, postChanges, path, body);
 }
 
 }
@@ -215,8 +941,10 @@ HandleStreamersPatch(
 
 std::pair<rest::StatusCode, MHD_Response*>
 rest::HandleRequest(
-    std::shared_ptr<Config>& streamersConfig,
+    const rest::GetConfigSnapshot& getConfigSnapshot,
     const rest::PostConfigChanges& postChanges,
+    const rest::GetStatsSnapshot& getStatsSnapshot,
+    const std::shared_ptr<StreamerEvents>& events,
     http::Method method,
     const char* uri,
     const std::string_view& body)
@@ -225,6 +953,7 @@ rest::HandleRequest(
         return InternalError();
 
     g_autofree gchar* path = nullptr;
+    g_autofree gchar* query = nullptr;
     if(!g_uri_split(
         uri,
         G_URI_FLAGS_NONE,
@@ -233,7 +962,7 @@ rest::HandleRequest(
         nullptr, //host
         nullptr, //port
         &path,
-        nullptr, //query
+        &query,
         nullptr, //fragment
         nullptr))
     {
@@ -245,6 +974,37 @@ rest::HandleRequest(
 
     const gchar* requestPath = path + ApiPrefixLen;
 
+    // the whole request is handled with the same snapshot,
+    // changes are applied by the main loop and become visible with the next one
+    const std::shared_ptr<const ConfigSnapshot> snapshot = getConfigSnapshot();
+    const std::shared_ptr<const Config> streamersConfig(snapshot, &snapshot->config);
+    const std::shared_ptr<const StatsSnapshot> statsSnapshot = getStatsSnapshot();
+
+    if(g_str_has_prefix(requestPath, EventsPrefix)) {
+        requestPath += EventsPrefixLen;
+        switch(method) {
+            case Method::GET:
+                return ApplyEventsHeaders(HandleEventsRequest(events, requestPath));
+            default:
+                return BadRequest();
+        }
+    }
+
+    if(g_str_has_prefix(requestPath, MetricsPrefix)) {
+        requestPath += MetricsPrefixLen;
+        switch(method) {
+            case Method::GET:
+                return
+                    ApplyMetricsHeaders(
+                        HandleMetricsRequest(
+                            streamersConfig,
+                            statsSnapshot,
+                            requestPath));
+            default:
+                return BadRequest();
+        }
+    }
+
     if(g_str_has_prefix(requestPath, StreamersPrefix)) {
         requestPath += StreamersPrefixLen;
         switch(method) {
@@ -252,13 +1012,15 @@ rest::HandleRequest(
                 return
                     ApplyDefaultHeaders(
                         HandleStreamersRequest(
-                            streamersConfig,
-                            requestPath));
+                            snapshot,
+                            requestPath,
+                            query),
+                        "no-cache");
             case Method::PATCH:
                 return
                     ApplyDefaultHeaders(
                         HandleStreamersPatch(
-                            streamersConfig,
+                            snapshot,
                             postChanges,
                             requestPath,
                             body));
@@ -6,6 +6,9 @@
 #include "Http/HttpMicroServer.h"
 
 #include "Config.h"
+#include "ConfigPublisher.h"
+#include "StatsSnapshot.h"
+#include "StreamerEvents.h"
 
 
 namespace rest
@@ -13,14 +16,18 @@ namespace rest
 
 extern const char *const ApiPrefix;
 
+typedef std::function<std::shared_ptr<const ConfigSnapshot> ()> GetConfigSnapshot;
 typedef std::function<void (std::unique_ptr<ConfigChanges>&& changes)> PostConfigChanges;
+typedef std::function<std::shared_ptr<const StatsSnapshot> ()> GetStatsSnapshot;
 
 typedef http::Method Method;
 typedef unsigned StatusCode;
 std::pair<rest::StatusCode, MHD_Response*>
 HandleRequest(
-    std::shared_ptr<Config>& streamersConfig,
+    const GetConfigSnapshot&, // it should be thread safe
     const PostConfigChanges&, // it should be thread safe
+    const GetStatsSnapshot&, // it should be thread safe
+    const std::shared_ptr<StreamerEvents>&,
     Method method,
     const char* uri,
     const std::string_view& body);
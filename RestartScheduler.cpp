@@ -0,0 +1,356 @@
+#include "RestartScheduler.h"
+
+#include <algorithm>
+
+#include "Log.h"
+
+
+static const auto Log = ReStreamerLog;
+
+namespace {
+
+// start not reported as playing or failed during it is considered stuck,
+// so its start slot is freed
+const gint64 InFlightTimeout = 15000; // ms
+
+}
+
+struct RestartScheduler::Entry
+{
+    Restart restart; // empty for reStreamers
+    unsigned failures = 0;
+    unsigned starts = 0;
+    unsigned restarts = 0;
+    gint64 lastStartTime = 0;
+
+    guint timeoutId = 0;
+    bool throttled = false;
+    unsigned delay = 0;
+    gint64 startTime = 0;
+};
+
+
+RestartScheduler::RestartScheduler(
+    const Config::RestartPolicy& policy,
+    const Start& start) :
+    _policy(policy), _start(start)
+{
+}
+
+std::string RestartScheduler::SourceId(const std::string& sourceUrl)
+{
+    return "source:" + sourceUrl;
+}
+
+std::string RestartScheduler::TargetId(const std::string& reStreamerId, size_t target)
+{
+    return "target:" + reStreamerId + "/" + std::to_string(target);
+}
+
+RestartScheduler::~RestartScheduler()
+{
+    for(auto& pair: _entries) {
+        if(pair.second.timeoutId)
+            g_source_remove(pair.second.timeoutId);
+    }
+
+    if(_slotTimeoutId)
+        g_source_remove(_slotTimeoutId);
+}
+
+unsigned RestartScheduler::nextDelay(unsigned failures) const noexcept
+{
+    // the first retry is fast to recover from short network blips quickly
+    const guint64 delay =
+        failures <= 1 ?
+            _policy.firstDelay :
+            std::min<guint64>(
+                static_cast<guint64>(_policy.minDelay) << std::min(failures - 2, 16u),
+                _policy.maxDelay);
+
+    // half of the delay is random to spread restarts of streamers failed at the same moment
+    const guint32 jitter = static_cast<guint32>(delay / 2);
+    return static_cast<unsigned>(delay - jitter + (jitter ? g_random_int_range(0, jitter + 1) : 0));
+}
+
+void RestartScheduler::admit(const std::string& reStreamerId) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        Entry& entry = _entries[reStreamerId];
+        if(entry.timeoutId || entry.throttled) {
+            Log()->debug("ReStreamer start already pending. Ignoring new request...");
+            return;
+        }
+
+        entry.throttled = true;
+        entry.startTime = g_get_monotonic_time();
+        _throttled.push_back(reStreamerId);
+    }
+
+    startThrottled();
+}
+
+void RestartScheduler::schedule(const std::string& id, const Restart& restart) noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    releaseInFlight(id);
+
+    Entry& entry = _entries[id];
+    if(entry.timeoutId || entry.throttled) {
+        Log()->debug("Restart of \"{}\" already pending. Ignoring new request...", id);
+        return;
+    }
+
+    entry.restart = restart;
+
+    const gint64 now = g_get_monotonic_time();
+    if(entry.lastStartTime &&
+        now - entry.lastStartTime >= static_cast<gint64>(_policy.resetAfter) * 1000)
+    {
+        entry.failures = 0; // was running long enough to consider it stable
+    }
+
+    ++entry.failures;
+    entry.delay = nextDelay(entry.failures);
+    entry.startTime = now + static_cast<gint64>(entry.delay) * 1000;
+
+    Log()->info(
+        "Restart of \"{}\" pending in {} ms (failure #{})...",
+        id,
+        entry.delay,
+        entry.failures);
+
+    typedef std::tuple<RestartScheduler*, std::string> Data;
+
+    auto onTimeout =
+        [] (gpointer userData) -> gboolean {
+            const auto& [self, id] = *static_cast<Data*>(userData);
+            self->onDelayElapsed(id);
+            return G_SOURCE_REMOVE;
+        };
+
+    entry.timeoutId = g_timeout_add_full(
+        G_PRIORITY_DEFAULT,
+        entry.delay,
+        GSourceFunc(onTimeout),
+        new Data(this, id),
+        [] (gpointer userData) {
+            delete static_cast<Data*>(userData);
+        });
+}
+
+void RestartScheduler::cancel(const std::string& id) noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    releaseInFlight(id);
+
+    const auto it = _entries.find(id);
+    if(it == _entries.end())
+        return;
+
+    Entry& entry = it->second;
+    if(entry.timeoutId) {
+        Log()->info("Cancelling pending restart of \"{}\"...", id);
+        g_source_remove(entry.timeoutId);
+        entry.timeoutId = 0;
+    }
+
+    if(entry.throttled) {
+        Log()->info("Cancelling pending restart of \"{}\"...", id);
+        _throttled.erase(std::find(_throttled.begin(), _throttled.end(), id));
+        entry.throttled = false;
+    }
+}
+
+void RestartScheduler::forget(const std::string& id) noexcept
+{
+    cancel(id);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.erase(id);
+}
+
+bool RestartScheduler::isPending(const std::string& id) const noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto it = _entries.find(id);
+    return it != _entries.end() && (it->second.timeoutId || it->second.throttled);
+}
+
+void RestartScheduler::started(const std::string& reStreamerId) noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    accountStart(reStreamerId, &_entries[reStreamerId], g_get_monotonic_time());
+}
+
+void RestartScheduler::playing(const std::string& id) noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    releaseInFlight(id);
+}
+
+void RestartScheduler::accountStart(const std::string& id, Entry* entry, gint64 now) noexcept
+{
+    // initial start of source or target is a part of reStreamer start
+    if(entry->starts || entry->restart)
+        ++entry->restarts;
+
+    entry->lastStartTime = now;
+    ++entry->starts;
+    _recentStarts.push_back(now);
+    _inFlight[id] = now;
+}
+
+// has to be called under _mutex
+void RestartScheduler::releaseInFlight(const std::string& id) noexcept
+{
+    if(!_inFlight.erase(id) || _throttled.empty())
+        return;
+
+    // throttled starts are resumed from the main loop,
+    // since it could be called from start of another one
+    armSlotTimeout(true);
+}
+
+bool RestartScheduler::hasFreeSlot(gint64 now) noexcept
+{
+    const gint64 windowStart = now - static_cast<gint64>(_policy.startWindow) * 1000;
+    while(!_recentStarts.empty() && _recentStarts.front() <= windowStart)
+        _recentStarts.pop_front();
+
+    const gint64 stuckStartTime = now - InFlightTimeout * 1000;
+    for(auto it = _inFlight.begin(); it != _inFlight.end();) {
+        if(it->second <= stuckStartTime) {
+            Log()->warn("Start of \"{}\" takes too long. Freeing its start slot...", it->first);
+            it = _inFlight.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return
+        (!_policy.maxConcurrentStarts || _recentStarts.size() < _policy.maxConcurrentStarts) &&
+        (!_policy.maxStartsInFlight || _inFlight.size() < _policy.maxStartsInFlight);
+}
+
+void RestartScheduler::onDelayElapsed(const std::string& id) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        Entry& entry = _entries[id];
+        entry.timeoutId = 0;
+        entry.throttled = true;
+        _throttled.push_back(id);
+    }
+
+    startThrottled();
+}
+
+void RestartScheduler::startThrottled() noexcept
+{
+    for(;;) {
+        std::string id;
+        Restart restart;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if(_throttled.empty())
+                return;
+
+            const gint64 now = g_get_monotonic_time();
+            if(!hasFreeSlot(now)) {
+                armSlotTimeout();
+                return;
+            }
+
+            id = _throttled.front();
+            _throttled.pop_front();
+
+            Entry& entry = _entries[id];
+            entry.throttled = false;
+            if(entry.restart) {
+                restart = entry.restart;
+                accountStart(id, &entry, now);
+            }
+        }
+
+        // could call back to scheduler
+        if(restart)
+            restart();
+        else
+            _start(id);
+    }
+}
+
+// has to be called under _mutex
+void RestartScheduler::armSlotTimeout(bool immediately) noexcept
+{
+    gint64 wait = 0;
+    if(immediately) {
+        if(_slotTimeoutId) {
+            g_source_remove(_slotTimeoutId);
+            _slotTimeoutId = 0;
+        }
+    } else {
+        if(_slotTimeoutId)
+            return;
+
+        // the nearest time start window slot is freed or start in flight is considered stuck
+        gint64 slotFreeTime = G_MAXINT64;
+        if(!_recentStarts.empty())
+            slotFreeTime = _recentStarts.front() + static_cast<gint64>(_policy.startWindow) * 1000;
+        for(const auto& [id, startTime]: _inFlight)
+            slotFreeTime = std::min(slotFreeTime, startTime + InFlightTimeout * 1000);
+        if(slotFreeTime == G_MAXINT64)
+            return;
+
+        Log()->debug("Start slots are exhausted. Delaying {} restarts...", _throttled.size());
+
+        wait = std::max<gint64>(slotFreeTime - g_get_monotonic_time(), 0);
+    }
+
+    auto onTimeout =
+        [] (gpointer userData) -> gboolean {
+            RestartScheduler* self = static_cast<RestartScheduler*>(userData);
+            {
+                std::lock_guard<std::mutex> lock(self->_mutex);
+                self->_slotTimeoutId = 0;
+            }
+            self->startThrottled();
+            return G_SOURCE_REMOVE;
+        };
+
+    _slotTimeoutId = g_timeout_add(
+        static_cast<guint>((wait + 999) / 1000),
+        GSourceFunc(onTimeout),
+        this);
+}
+
+std::map<std::string, RestartScheduler::State> RestartScheduler::states() const noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::map<std::string, State> states;
+    for(const auto& [id, entry]: _entries) {
+        states.emplace(
+            id,
+            State {
+                .failures = entry.failures,
+                .restarts = entry.restarts,
+                .pending = entry.timeoutId != 0 || entry.throttled,
+                .throttled = entry.throttled,
+                .delay = entry.delay,
+                .startTime = entry.startTime,
+            });
+    }
+
+    return states;
+}
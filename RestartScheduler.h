@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <map>
+#include <deque>
+#include <mutex>
+
+#include <glib.h>
+
+#include "Config.h"
+
+
+// Schedules reStreamers, sources and RTMP targets restarts
+// with exponential backoff and jitter,
+// limiting both the number of starts in flight (started, but not playing or failed yet)
+// and the number of starts inside start window.
+// Initial reStreamers starts are admitted through the same start slots.
+// Has to be used from the main context (except states()).
+class RestartScheduler
+{
+public:
+    typedef std::function<void (const std::string& reStreamerId)> Start;
+    typedef std::function<void ()> Restart;
+
+    struct State
+    {
+        unsigned failures; // consecutive failures since last stable run
+        unsigned restarts; // total starts except the initial one
+        bool pending; // restart is scheduled
+        bool throttled; // backoff delay elapsed, waiting for free start slot
+        unsigned delay; // ms, backoff delay of last scheduled restart
+        gint64 startTime; // monotonic time (us) restart is scheduled at
+    };
+
+    RestartScheduler(const Config::RestartPolicy&, const Start&);
+    ~RestartScheduler();
+
+    // ids of source and RTMP target entries,
+    // to not mix them with reStreamers ids
+    static std::string SourceId(const std::string& sourceUrl);
+    static std::string TargetId(const std::string& reStreamerId, size_t target);
+
+    // queues initial start without backoff delay,
+    // reStreamers are started in admission order as start slots allow
+    void admit(const std::string& reStreamerId) noexcept;
+    // has to be called on every reStreamer, source or RTMP target failure
+    // (it frees start slot in flight).
+    // for sources and targets restart is called instead of Start,
+    // and scheduler accounts their starts itself,
+    // so entry has to be forgotten before restart becomes invalid
+    void schedule(const std::string& id, const Restart& restart = Restart()) noexcept;
+    // cancels pending restart, backoff history is kept
+    void cancel(const std::string& id) noexcept;
+    void forget(const std::string& id) noexcept;
+    bool isPending(const std::string& id) const noexcept;
+
+    // has to be called on every reStreamer start
+    // (even not initiated by scheduler) to account start slots
+    void started(const std::string& reStreamerId) noexcept;
+    // has to be called when reStreamer, source or RTMP target reaches playing state
+    // to free its start slot in flight
+    void playing(const std::string& id) noexcept;
+
+    // thread safe
+    std::map<std::string, State> states() const noexcept;
+
+private:
+    struct Entry;
+
+    unsigned nextDelay(unsigned failures) const noexcept;
+    void accountStart(const std::string& id, Entry*, gint64 now) noexcept;
+    void releaseInFlight(const std::string& id) noexcept;
+    bool hasFreeSlot(gint64 now) noexcept;
+    void onDelayElapsed(const std::string& id) noexcept;
+    void startThrottled() noexcept;
+    void armSlotTimeout(bool immediately = false) noexcept;
+
+private:
+    const Config::RestartPolicy _policy;
+    const Start _start;
+
+    mutable std::mutex _mutex;
+    std::map<std::string, Entry> _entries;
+    std::deque<std::string> _throttled; // waiting for free start slot in FIFO order
+    std::deque<gint64> _recentStarts; // starts inside start window
+    std::map<std::string, gint64> _inFlight; // id -> start time
+    guint _slotTimeoutId = 0;
+};
@@ -0,0 +1,129 @@
+#include "SilentAudio.h"
+
+#include <algorithm>
+#include <iterator>
+
+
+namespace {
+
+// AAC LC raw_data_block: single channel element
+// without scale factor bands (i.e. silence) followed by END element
+const guint8 SilentAacFrame[] = { 0x01, 0x40, 0x20, 0x07 };
+// the same for channel pair element without common window
+const guint8 SilentAacStereoFrame[] = { 0x20, 0xa0, 0x10, 0x02, 0x80, 0x40, 0x0e };
+const gint SilentAacRate = 44100;
+const guint64 SilentAacFrameSamples = 1024;
+
+// AudioSpecificConfig sampling frequency index is position in this table
+const gint AacRates[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350 };
+
+GstBuffer* WrapStatic(const guint8* data, gsize size)
+{
+    return
+        gst_buffer_new_wrapped_full(
+            GST_MEMORY_FLAG_READONLY,
+            const_cast<guint8*>(data),
+            size,
+            0,
+            size,
+            nullptr,
+            nullptr);
+}
+
+}
+
+
+SilentAudio::SilentAudio()
+{
+    setFormat(SilentAacRate, 1);
+}
+
+void SilentAudio::setFormat(gint rate, gint channels) noexcept
+{
+    const gint* rateIt = std::find(std::begin(AacRates), std::end(AacRates), rate);
+    if(rateIt == std::end(AacRates) || channels <= 0) {
+        rateIt = std::find(std::begin(AacRates), std::end(AacRates), SilentAacRate);
+        channels = 1;
+    }
+    channels = std::min(channels, 2);
+
+    if(_capsPtr && *rateIt == _rate && channels == (_frame == SilentAacFrame ? 1 : 2))
+        return;
+
+    _rate = *rateIt;
+    if(channels == 1) {
+        _frame = SilentAacFrame;
+        _frameSize = sizeof(SilentAacFrame);
+    } else {
+        _frame = SilentAacStereoFrame;
+        _frameSize = sizeof(SilentAacStereoFrame);
+    }
+
+    // AudioSpecificConfig: object type (AAC LC), sampling frequency index, channel configuration
+    const guint8 rateIndex = rateIt - std::begin(AacRates);
+    guint8* codecDataBytes = static_cast<guint8*>(g_malloc(2));
+    codecDataBytes[0] = (2 << 3) | (rateIndex >> 1);
+    codecDataBytes[1] = ((rateIndex & 1) << 7) | (channels << 3);
+    GstBuffer* codecData = gst_buffer_new_wrapped(codecDataBytes, 2);
+
+    _capsPtr.reset(
+        gst_caps_new_simple(
+            "audio/mpeg",
+            "mpegversion", G_TYPE_INT, 4,
+            "stream-format", G_TYPE_STRING, "raw",
+            "framed", G_TYPE_BOOLEAN, TRUE,
+            "rate", G_TYPE_INT, _rate,
+            "channels", G_TYPE_INT, channels,
+            "codec_data", GST_TYPE_BUFFER, codecData,
+            nullptr));
+    gst_buffer_unref(codecData);
+}
+
+void SilentAudio::reset() noexcept
+{
+    _startTime = GST_CLOCK_TIME_NONE;
+    _framesCount = 0;
+}
+
+GstClockTime SilentAudio::frameTime(guint64 frameIndex) const noexcept
+{
+    // calculated from frame index to avoid rounding errors accumulation
+    return _startTime +
+        gst_util_uint64_scale_int(
+            frameIndex * SilentAacFrameSamples,
+            GST_SECOND,
+            _rate);
+}
+
+void SilentAudio::generate(
+    GstClockTime time,
+    const GstSegment* segment,
+    const std::function<void (GstSample*)>& onSample) noexcept
+{
+    if(!GST_CLOCK_TIME_IS_VALID(time))
+        return;
+
+    if(!GST_CLOCK_TIME_IS_VALID(_startTime)) {
+        _startTime = time;
+        _framesCount = 0;
+    }
+
+    for(GstClockTime frameTime = this->frameTime(_framesCount);
+        frameTime <= time;
+        frameTime = this->frameTime(_framesCount))
+    {
+        // frame data is never copied
+        GstBuffer* buffer = WrapStatic(_frame, _frameSize);
+        GST_BUFFER_PTS(buffer) = frameTime;
+        GST_BUFFER_DTS(buffer) = frameTime;
+        GST_BUFFER_DURATION(buffer) = this->frameTime(_framesCount + 1) - frameTime;
+
+        g_autoptr(GstSample) sample = gst_sample_new(buffer, _capsPtr.get(), segment, nullptr);
+        gst_buffer_unref(buffer);
+
+        ++_framesCount;
+
+        onSample(sample);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <functional>
+
+#include <gst/gst.h>
+
+#include <CxxPtr/GstPtr.h>
+
+
+// Generator of precomputed silent AAC LC frames (44100 Hz, mono by default)
+class SilentAudio
+{
+public:
+    SilentAudio();
+
+    // FLV supports mono and stereo only, so other channels count is taken as stereo.
+    // unsupported rate or 0 (i.e. unknown) falls back to 44100 Hz mono.
+    // has to be followed by reset()
+    void setFormat(gint rate, gint channels) noexcept;
+
+    // produces frames to fill audio up to (including) time.
+    // the first call after construction/reset() starts silence from time
+    void generate(
+        GstClockTime time,
+        const GstSegment*,
+        const std::function<void (GstSample*)>& onSample) noexcept;
+    void reset() noexcept;
+
+private:
+    GstClockTime frameTime(guint64 frameIndex) const noexcept;
+
+private:
+    gint _rate = 0;
+    const guint8* _frame = nullptr;
+    gsize _frameSize = 0;
+    GstCapsPtr _capsPtr;
+
+    GstClockTime _startTime = GST_CLOCK_TIME_NONE;
+    guint64 _framesCount = 0;
+};
@@ -0,0 +1,109 @@
+#include "Slate.h"
+
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <memory>
+
+#include <gst/app/gstappsink.h>
+
+#include <CxxPtr/GlibPtr.h>
+#include <CxxPtr/GstPtr.h>
+
+#include "Log.h"
+
+
+static const auto Log = ReStreamerLog;
+
+namespace {
+
+const GstClockTime EncodeTimeout = 5 * GST_SECOND;
+
+typedef std::tuple<std::string, int, int> SlateKey; // image path, width, height
+
+struct SharedSlateEntry
+{
+    GstSamplePtr samplePtr; // nullptr while encoding or if failed to encode
+};
+
+std::mutex SharedSlatesMutex;
+std::map<SlateKey, SharedSlateEntry> SharedSlates; // accessed under SharedSlatesMutex
+GThreadPool* SlateEncoder = nullptr; // created on first use under SharedSlatesMutex
+
+void EncodeSharedSlate(gpointer data, gpointer /*userData*/)
+{
+    std::unique_ptr<SlateKey> keyPtr(static_cast<SlateKey*>(data));
+    const auto& [imagePath, width, height] = *keyPtr;
+
+    GstSamplePtr samplePtr(EncodeSlate(imagePath, width, height));
+
+    std::lock_guard<std::mutex> lock(SharedSlatesMutex);
+
+    SharedSlates[*keyPtr].samplePtr = std::move(samplePtr);
+}
+
+}
+
+
+GstSample* EncodeSlate(const std::string& imagePath, int width, int height) noexcept
+{
+    // image is letterboxed if its aspect ratio differs
+    g_autofree gchar* size =
+        width > 0 && height > 0 ?
+            g_strdup_printf(", width=%d, height=%d, pixel-aspect-ratio=1/1", width, height) :
+            g_strdup("");
+    g_autofree gchar* pipelineDesc = g_strdup_printf(
+        "filesrc name=src ! decodebin ! videoconvert ! videoscale ! video/x-raw, format=I420%s ! "
+        "x264enc key-int-max=1 tune=zerolatency ! "
+        "h264parse ! video/x-h264, stream-format=avc, alignment=au ! "
+        "appsink name=sink sync=false",
+        size);
+
+    g_autoptr(GError) parseError = nullptr;
+    GstElementPtr pipelinePtr(gst_parse_launch(pipelineDesc, &parseError));
+    if(parseError) {
+        Log()->error("Failed to create slate encoding pipeline: {}", parseError->message);
+        return nullptr;
+    }
+
+    GstElement* pipeline = pipelinePtr.get();
+
+    GstElementPtr srcPtr(gst_bin_get_by_name(GST_BIN(pipeline), "src"));
+    g_object_set(srcPtr.get(), "location", imagePath.c_str(), nullptr);
+
+    GstElementPtr sinkPtr(gst_bin_get_by_name(GST_BIN(pipeline), "sink"));
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    GstSample* sample =
+        gst_app_sink_try_pull_sample(GST_APP_SINK(sinkPtr.get()), EncodeTimeout);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+
+    if(!sample)
+        Log()->error("Failed to encode slate image \"{}\"", imagePath);
+
+    return sample;
+}
+
+GstSample* SharedSlate(const std::string& imagePath, int width, int height) noexcept
+{
+    SlateKey key(imagePath, width, height);
+
+    std::lock_guard<std::mutex> lock(SharedSlatesMutex);
+
+    const auto [it, inserted] = SharedSlates.emplace(key, SharedSlateEntry());
+    if(!inserted) {
+        const SharedSlateEntry& entry = it->second;
+        return entry.samplePtr ? gst_sample_ref(entry.samplePtr.get()) : nullptr;
+    }
+
+    if(!SlateEncoder) {
+        // single thread is enough since every slate is encoded once
+        SlateEncoder = g_thread_pool_new(EncodeSharedSlate, nullptr, 1, FALSE, nullptr);
+    }
+
+    g_thread_pool_push(SlateEncoder, new SlateKey(std::move(key)), nullptr);
+
+    return nullptr;
+}
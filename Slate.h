@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include <gst/gst.h>
+
+
+// encodes image scaled to width x height (0 - image size)
+// to single H.264 keyframe suitable for flvmux.
+// returns sample (transfer full) or nullptr on failure.
+// blocks until image is encoded.
+GstSample* EncodeSlate(const std::string& imagePath, int width = 0, int height = 0) noexcept;
+
+// thread safe, never blocks.
+// slates are shared by all callers:
+// every distinct image and size is encoded only once on background thread.
+// returns sample (transfer full) if it's encoded already,
+// otherwise returns nullptr and queues encoding if it's not queued yet
+GstSample* SharedSlate(const std::string& imagePath, int width, int height) noexcept;
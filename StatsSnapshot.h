@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <map>
+
+#include <glib.h>
+
+#include "RestartScheduler.h"
+#include "ReStreamer.h"
+
+
+// runtime state sampled by the main loop periodically,
+// never changed after publishing
+struct StatsSnapshot
+{
+    guint64 version; // grows with every sample
+    gint64 time; // monotonic time (us) of sampling
+    gint64 startupDuration; // us from startup till all enabled reStreamers were streaming, -1 - not yet
+    std::map<std::string, RestartScheduler::State> restartStates; // reStreamerId -> state
+    std::map<std::string, ReStreamer::Stats> reStreamers; // reStreamerId -> stats
+};
@@ -0,0 +1,447 @@
+#include "StreamerControl.h"
+
+#include <cassert>
+#include <algorithm>
+
+#include "Log.h"
+
+
+static const auto Log = ReStreamerLog;
+
+
+namespace {
+
+// description and priority are the only properties not affecting running pipelines
+bool SameReStreaming(const Config::ReStreamer& l, const Config::ReStreamer& r)
+{
+    return
+        l.sourceUrl == r.sourceUrl &&
+        l.targetUrls == r.targetUrls &&
+        l.enabled == r.enabled &&
+        l.forceH264ProfileLevelId == r.forceH264ProfileLevelId &&
+        l.queueBudget.maxLatency == r.queueBudget.maxLatency &&
+        l.queueBudget.maxBytes == r.queueBudget.maxBytes &&
+        l.queueBudget.overflowPolicy == r.queueBudget.overflowPolicy &&
+        l.stallTimeout == r.stallTimeout &&
+        l.fallback == r.fallback &&
+        l.fallbackImage == r.fallbackImage;
+}
+
+}
+
+
+StreamerControl::StreamerControl(
+    const Config& config,
+    const SourceRemoved& sourceRemoved) :
+    _config(config), _index(config), _sourceRemoved(sourceRemoved),
+    _workerPool(std::make_unique<WorkerPool>(config.workerThreads)),
+    _restartScheduler(
+        std::make_unique<RestartScheduler>(
+            config.restartPolicy,
+            [this] (const std::string& reStreamerId) {
+                startReStream(reStreamerId);
+            }))
+{
+}
+
+StreamerControl::~StreamerControl()
+{
+    _restartScheduler.reset();
+
+    // reStreamers have to be detached from ingests first
+    _reStreamers.clear();
+    _ingests.clear();
+}
+
+Ingest* StreamerControl::acquireIngest(const std::string& sourceUrl) noexcept
+{
+    auto it = _ingests.find(sourceUrl);
+    if(it == _ingests.end()) {
+        Log()->info("Connecting to source \"{}\"...", sourceUrl);
+
+        it = _ingests.emplace(
+            std::piecewise_construct,
+            std::forward_as_tuple(sourceUrl),
+            std::forward_as_tuple(
+                sourceUrl,
+                _workerPool->nextContext(),
+                [this, sourceUrl] () {
+                    _restartScheduler->playing(RestartScheduler::SourceId(sourceUrl));
+                },
+                [this, sourceUrl] () {
+                    ingestEos(sourceUrl);
+                }
+            )).first;
+
+        it->second.start();
+    }
+
+    return &(it->second);
+}
+
+void StreamerControl::releaseIngest(const std::string& sourceUrl) noexcept
+{
+    const auto it = _ingests.find(sourceUrl);
+    if(it == _ingests.end() || it->second.hasConsumers())
+        return;
+
+    Log()->info("Disconnecting from unused source \"{}\"...", sourceUrl);
+    _restartScheduler->forget(RestartScheduler::SourceId(sourceUrl));
+    _ingests.erase(it);
+}
+
+void StreamerControl::detachFromIngest(
+    const std::string& sourceUrl,
+    Ingest::Consumer* consumer) noexcept
+{
+    const auto it = _ingests.find(sourceUrl);
+    if(it == _ingests.end())
+        return;
+
+    it->second.detach(consumer);
+    releaseIngest(sourceUrl);
+}
+
+void StreamerControl::ingestEos(const std::string& sourceUrl) noexcept
+{
+    const auto it = _ingests.find(sourceUrl);
+    if(it == _ingests.end())
+        return;
+
+    // source reconnects get the same backoff and start slots as reStreamers restarts
+    Ingest* ingest = &(it->second);
+    _restartScheduler->schedule(
+        RestartScheduler::SourceId(sourceUrl),
+        [ingest] () { ingest->start(); });
+
+    const auto affectedReStreamersCount =
+        std::count_if(
+            _reStreamers.begin(),
+            _reStreamers.end(),
+            [&sourceUrl] (const auto& pair) {
+                return pair.second.sourceUrl() == sourceUrl;
+            });
+
+    // reStreamers keep RTMP connections waiting for source
+    if(affectedReStreamersCount) {
+        Log()->info(
+            "Source \"{}\" lost. {} reStreamer(s) keep RTMP connections while it reconnects...",
+            sourceUrl,
+            affectedReStreamersCount);
+    }
+}
+
+void StreamerControl::stopReStream(const std::string& reStreamerId) noexcept
+{
+    _restartScheduler->cancel(reStreamerId);
+
+    const auto& it = _reStreamers.find(reStreamerId);
+    if(it != _reStreamers.end()) {
+        const std::string sourceUrl = it->second.sourceUrl();
+        Log()->info("Stopping active reStreaming \"{}\" (\"{}\")...", sourceUrl, reStreamerId);
+        for(size_t target = 0; target < it->second.targetsCount(); ++target)
+            _restartScheduler->forget(RestartScheduler::TargetId(reStreamerId, target));
+        _reStreamers.erase(it);
+        releaseIngest(sourceUrl);
+    }
+}
+
+void StreamerControl::startReStream(const std::string& reStreamerId) noexcept
+{
+    assert(_reStreamers.find(reStreamerId) == _reStreamers.end());
+    stopReStream(reStreamerId);
+
+    const auto configIt = _config.reStreamers.find(reStreamerId);
+    if(configIt == _config.reStreamers.end()) {
+        Log()->error("Can't find reStreamer with id \"{}\"", reStreamerId);
+        return;
+    }
+
+    const Config::ReStreamer& reStreamerConfig = configIt->second;
+
+    const auto reStreamerIt = _reStreamers.find(reStreamerId);
+
+    if(reStreamerConfig.enabled) {
+        if(reStreamerIt == _reStreamers.end()) {
+            Log()->info("ReStreaming \"{}\" (\"{}\")", reStreamerConfig.sourceUrl, reStreamerId);
+        } else {
+            Log()->warn(
+                "Ignoring reStreaming request for already reStreaming source \"{}\" (\"{}\")...",
+                reStreamerConfig.sourceUrl,
+                reStreamerId);
+        }
+    } else {
+        Log()->debug(
+            "Ignoring reStreaming request for disabled source \"{}\" (\"{}\")...",
+            reStreamerConfig.sourceUrl,
+            reStreamerId);
+        assert(reStreamerIt == _reStreamers.end());
+        return;
+    }
+
+    auto [it, inserted] = _reStreamers.emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(reStreamerId),
+        std::forward_as_tuple(
+            acquireIngest(reStreamerConfig.sourceUrl),
+            reStreamerConfig,
+            _workerPool->nextContext(),
+            [this, reStreamerId] (size_t target) {
+                _restartScheduler->playing(RestartScheduler::TargetId(reStreamerId, target));
+            },
+            [this, reStreamerId] (size_t target) {
+                targetEos(reStreamerId, target);
+            },
+            [this, reStreamerId] () {
+                _restartScheduler->playing(reStreamerId);
+            },
+            [this, reStreamerId] () {
+                // it's required to do reStreamerId copy
+                // since ReStreamer instance
+                // will be destroyed inside scheduleStartReStream
+                // and as consequence current lambda with all captures
+                // will be destroyed too
+                scheduleStartReStream(std::string(reStreamerId));
+            }
+        ));
+    assert(inserted);
+
+    _restartScheduler->started(reStreamerId);
+
+    it->second.start();
+}
+
+void StreamerControl::targetEos(const std::string& reStreamerId, size_t target) noexcept
+{
+    const auto it = _reStreamers.find(reStreamerId);
+    if(it == _reStreamers.end())
+        return;
+
+    ReStreamer* reStreamer = &(it->second);
+    _restartScheduler->schedule(
+        RestartScheduler::TargetId(reStreamerId, target),
+        [reStreamer, target] () { reStreamer->restartTarget(target); });
+}
+
+void StreamerControl::scheduleStartReStream(const std::string& reStreamerId) noexcept
+{
+    if(_restartScheduler->isPending(reStreamerId)) {
+        Log()->debug("ReStreamer restart already pending. Ignoring new request...");
+        return;
+    }
+
+    assert(_reStreamers.find(reStreamerId) != _reStreamers.end());
+    stopReStream(reStreamerId);
+
+    _restartScheduler->schedule(reStreamerId);
+}
+
+void StreamerControl::sourceMaybeRemoved(const std::string& sourceUrl) noexcept
+{
+    if(_index.findBySource(sourceUrl))
+        return;
+
+    if(_sourceRemoved)
+        _sourceRemoved(sourceUrl);
+}
+
+void StreamerControl::addReStreamer(
+    const std::string& uniqueId,
+    const Config::ReStreamer& reStreamerConfig) noexcept
+{
+    const auto [it, inserted] = _config.reStreamers.emplace(uniqueId, reStreamerConfig);
+    if(!inserted) {
+        Log()->warn("Got add request for already existing reStreamer \"{}\"", uniqueId);
+        return;
+    }
+    _config.reStreamersOrder.emplace_back(uniqueId);
+    _index.insert(reStreamerConfig.sourceUrl, reStreamerConfig.targetUrls, uniqueId);
+
+    Log()->info("Adding reStreamer \"{}\" (\"{}\")...", reStreamerConfig.sourceUrl, uniqueId);
+
+    startReStream(uniqueId);
+}
+
+void StreamerControl::removeReStreamer(const std::string& uniqueId) noexcept
+{
+    const auto it = _config.reStreamers.find(uniqueId);
+    if(it == _config.reStreamers.end()) {
+        Log()->warn("Got remove request for unknown reStreamer \"{}\"", uniqueId);
+        return;
+    }
+
+    const std::string sourceUrl = it->second.sourceUrl;
+
+    Log()->info("Removing reStreamer \"{}\" (\"{}\")...", sourceUrl, uniqueId);
+
+    stopReStream(uniqueId);
+    _restartScheduler->forget(uniqueId);
+
+    _index.erase(sourceUrl, it->second.targetUrls, uniqueId);
+    _config.reStreamers.erase(it);
+    auto& order = _config.reStreamersOrder;
+    order.erase(std::remove(order.begin(), order.end(), uniqueId), order.end());
+
+    sourceMaybeRemoved(sourceUrl);
+}
+
+void StreamerControl::applyChanges(const ConfigChanges& changes) noexcept
+{
+    for(const auto& pair: changes.reStreamersChanges) {
+        const std::string& uniqueId = pair.first;
+        const ConfigChanges::ReStreamerChanges& reStreamerChanges = pair.second;
+
+        if(reStreamerChanges.added) {
+            // REST API checks duplicates on config snapshot, so concurrent requests could pass it
+            const Config::ReStreamer& added = *reStreamerChanges.added;
+            if(_index.find(added.sourceUrl, added.targetUrls)) {
+                Log()->warn("Got add request for reStreamer \"{}\" duplicating existing one", uniqueId);
+                continue;
+            }
+
+            Config::ReStreamer addedConfig = *reStreamerChanges.added;
+            addedConfig.dynamic = true;
+            addReStreamer(uniqueId, addedConfig);
+            continue;
+        }
+
+        if(reStreamerChanges.removed) {
+            removeReStreamer(uniqueId);
+            continue;
+        }
+
+        const auto& it = _config.reStreamers.find(uniqueId);
+        if(it == _config.reStreamers.end()) {
+            Log()->warn("Got change request for unknown reStreamer \"{}\"", uniqueId);
+            continue;
+        }
+
+        Config::ReStreamer& reStreamerConfig = it->second;
+
+        if(reStreamerChanges.sourceUrl || reStreamerChanges.targetUrls) {
+            const std::string* sameId = _index.find(
+                reStreamerChanges.sourceUrl ? *reStreamerChanges.sourceUrl : reStreamerConfig.sourceUrl,
+                reStreamerChanges.targetUrls ? *reStreamerChanges.targetUrls : reStreamerConfig.targetUrls);
+            if(sameId && *sameId != uniqueId) {
+                Log()->warn("Got change request for reStreamer \"{}\" duplicating \"{}\"", uniqueId, *sameId);
+                continue;
+            }
+        }
+
+        if(!reStreamerConfig.dynamic && !reStreamerConfig.modified) {
+            // to find reStreamer in user config on the next load
+            reStreamerConfig.modified = true;
+            reStreamerConfig.originSourceUrl = reStreamerConfig.sourceUrl;
+            reStreamerConfig.originTargetUrls = reStreamerConfig.targetUrls;
+        }
+
+        if(reStreamerChanges.description)
+            reStreamerConfig.description = *reStreamerChanges.description;
+
+        bool restartRequired = false;
+
+        if(reStreamerChanges.enabled &&
+            reStreamerConfig.enabled != *reStreamerChanges.enabled)
+        {
+            reStreamerConfig.enabled = *reStreamerChanges.enabled;
+            restartRequired = true;
+        }
+
+        _index.erase(reStreamerConfig.sourceUrl, reStreamerConfig.targetUrls, uniqueId);
+
+        if(reStreamerChanges.targetUrls &&
+            reStreamerConfig.targetUrls != *reStreamerChanges.targetUrls)
+        {
+            reStreamerConfig.targetUrls = *reStreamerChanges.targetUrls;
+            restartRequired = true;
+        }
+
+        std::optional<std::string> prevSourceUrl;
+        if(reStreamerChanges.sourceUrl &&
+            reStreamerConfig.sourceUrl != *reStreamerChanges.sourceUrl)
+        {
+            prevSourceUrl = reStreamerConfig.sourceUrl;
+            reStreamerConfig.sourceUrl = *reStreamerChanges.sourceUrl;
+            restartRequired = true;
+        }
+
+        _index.insert(reStreamerConfig.sourceUrl, reStreamerConfig.targetUrls, uniqueId);
+
+        if(restartRequired) {
+            stopReStream(uniqueId);
+            if(reStreamerConfig.enabled)
+                startReStream(uniqueId);
+        }
+
+        if(prevSourceUrl)
+            sourceMaybeRemoved(*prevSourceUrl);
+    }
+}
+
+// reStreamers are started through restart scheduler start slots,
+// so sources and targets are not flooded with simultaneous connections
+std::deque<std::string> StreamerControl::admitReStreamers() noexcept
+{
+    std::deque<std::string> startOrder;
+    for(const std::string& uniqueId: _config.reStreamersOrder) {
+        const Config::ReStreamer& reStreamer = _config.reStreamers.at(uniqueId);
+        if(reStreamer.enabled)
+            startOrder.push_back(uniqueId);
+    }
+
+    std::stable_sort(
+        startOrder.begin(),
+        startOrder.end(),
+        [this] (const std::string& l, const std::string& r) {
+            return _config.reStreamers.at(l).priority > _config.reStreamers.at(r).priority;
+        });
+
+    Log()->info("Starting {} reStreamers...", startOrder.size());
+
+    for(const std::string& uniqueId: startOrder)
+        _restartScheduler->admit(uniqueId);
+
+    return startOrder;
+}
+
+bool StreamerControl::replaceReStreamer(
+    const std::string& uniqueId,
+    const Config::ReStreamer& newConfig) noexcept
+{
+    Config::ReStreamer& reStreamerConfig = _config.reStreamers.at(uniqueId);
+
+    if(SameReStreaming(reStreamerConfig, newConfig)) {
+        reStreamerConfig = newConfig;
+        return false;
+    }
+
+    Log()->info("Reconfiguring reStreamer \"{}\" (\"{}\")...", newConfig.sourceUrl, uniqueId);
+
+    const std::string prevSourceUrl = reStreamerConfig.sourceUrl;
+    _index.erase(reStreamerConfig.sourceUrl, reStreamerConfig.targetUrls, uniqueId);
+    reStreamerConfig = newConfig;
+    _index.insert(reStreamerConfig.sourceUrl, reStreamerConfig.targetUrls, uniqueId);
+
+    stopReStream(uniqueId);
+    if(reStreamerConfig.enabled)
+        startReStream(uniqueId);
+
+    if(prevSourceUrl != reStreamerConfig.sourceUrl)
+        sourceMaybeRemoved(prevSourceUrl);
+
+    return true;
+}
+
+std::map<std::string, RestartScheduler::State> StreamerControl::restartStates() const noexcept
+{
+    return _restartScheduler->states();
+}
+
+std::map<std::string, ReStreamer::Stats> StreamerControl::stats() const noexcept
+{
+    std::map<std::string, ReStreamer::Stats> stats;
+    for(const auto& [reStreamerId, reStreamer]: _reStreamers)
+        stats.emplace(reStreamerId, reStreamer.stats());
+
+    return stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <deque>
+#include <memory>
+#include <functional>
+
+#include "Config.h"
+#include "WorkerPool.h"
+#include "RestartScheduler.h"
+#include "StreamerIndex.h"
+#include "Ingest.h"
+#include "ReStreamer.h"
+
+
+// Runs reStreamers of the config:
+// shares source connections between reStreamers and previews,
+// (re)starts reStreamers, sources and RTMP targets through RestartScheduler
+// and applies config changes to running reStreamers.
+// Used by the application and benchmarks the same way.
+// Has to be used from the main context.
+class StreamerControl
+{
+public:
+    // called when the last reStreamer of the source was removed from config
+    // or moved to another source
+    typedef std::function<void (const std::string& sourceUrl)> SourceRemoved;
+
+    StreamerControl(const Config&, const SourceRemoved&);
+    ~StreamerControl();
+
+    Config& config() { return _config; }
+    const Config& config() const { return _config; }
+    const StreamerIndex& index() const { return _index; }
+
+    // queues start of all enabled reStreamers in priority order,
+    // returns ids of admitted reStreamers
+    std::deque<std::string> admitReStreamers() noexcept;
+
+    void addReStreamer(const std::string& uniqueId, const Config::ReStreamer&) noexcept;
+    void removeReStreamer(const std::string& uniqueId) noexcept;
+    // returns true if reStreamer was rebuilt
+    bool replaceReStreamer(const std::string& uniqueId, const Config::ReStreamer&) noexcept;
+    // only reStreamers affected by changes are rebuilt
+    void applyChanges(const ConfigChanges&) noexcept;
+
+    // ingest is connected on the first use and disconnected
+    // when the last consumer detaches from it
+    Ingest* acquireIngest(const std::string& sourceUrl) noexcept;
+    void detachFromIngest(const std::string& sourceUrl, Ingest::Consumer*) noexcept;
+
+    size_t ingestsCount() const { return _ingests.size(); }
+    std::map<std::string, RestartScheduler::State> restartStates() const noexcept;
+    std::map<std::string, ReStreamer::Stats> stats() const noexcept; // running reStreamers only
+
+private:
+    void releaseIngest(const std::string& sourceUrl) noexcept;
+    void ingestEos(const std::string& sourceUrl) noexcept;
+
+    void startReStream(const std::string& reStreamerId) noexcept;
+    void stopReStream(const std::string& reStreamerId) noexcept;
+    void scheduleStartReStream(const std::string& reStreamerId) noexcept;
+    void targetEos(const std::string& reStreamerId, size_t target) noexcept;
+
+    void sourceMaybeRemoved(const std::string& sourceUrl) noexcept;
+
+private:
+    Config _config;
+    StreamerIndex _index; // of _config reStreamers
+    const SourceRemoved _sourceRemoved;
+
+    std::unique_ptr<WorkerPool> _workerPool; // has to outlive all pipelines
+    std::map<std::string, Ingest> _ingests; // sourceUrl -> Ingest
+    std::map<std::string, ReStreamer> _reStreamers; // reStreamerId -> ReStreamer
+    std::unique_ptr<RestartScheduler> _restartScheduler;
+};
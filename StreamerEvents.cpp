@@ -0,0 +1,259 @@
+#include "StreamerEvents.h"
+
+#include <cassert>
+
+#include <glib.h>
+#include <jansson.h>
+
+
+namespace {
+
+const size_t HistorySize = 30; // events
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(json_t, json_decref)
+typedef char* json_char_ptr;
+G_DEFINE_AUTO_CLEANUP_FREE_FUNC(json_char_ptr, free, nullptr)
+
+const char* StateName(
+    const Config::ReStreamer& config,
+    const StatsSnapshot& stats,
+    const std::string& reStreamerId)
+{
+    if(!config.enabled)
+        return "disabled";
+
+    const auto restartStateIt = stats.restartStates.find(reStreamerId);
+    if(restartStateIt != stats.restartStates.end() && restartStateIt->second.pending)
+        return restartStateIt->second.failures ? "restarting" : "queued"; // waiting for start slot on startup
+
+    const auto statsIt = stats.reStreamers.find(reStreamerId);
+    if(statsIt == stats.reStreamers.end())
+        return "error"; // enabled, but failed to start
+
+    if(statsIt->second.fallback)
+        return "fallback";
+
+    return statsIt->second.streaming ? "streaming" : "connecting";
+}
+
+json_t* StateToJson(
+    const std::string& reStreamerId,
+    const Config::ReStreamer& config,
+    const StatsSnapshot& stats)
+{
+    json_t* object = json_object();
+    json_object_set_new(object, "id", json_string(reStreamerId.c_str()));
+    json_object_set_new(object, "source", json_string(config.sourceUrl.c_str()));
+    json_object_set_new(object, "description", json_string(config.description.c_str()));
+    json_object_set_new(object, "enabled", json_boolean(config.enabled));
+    json_object_set_new(object, "state", json_string(StateName(config, stats, reStreamerId)));
+
+    return object;
+}
+
+// rates are calculated from counters difference since previous tick
+json_t* StatsToJson(
+    const ReStreamer::Stats& stats,
+    const ReStreamer::Stats* prevStats,
+    gint64 interval) // us
+{
+    json_t* object = json_object();
+
+    // counters are reset on reStreamer restart
+    if(prevStats &&
+        prevStats->startTime == stats.startTime &&
+        interval > 0)
+    {
+        const guint64 videoFrames = stats.muxedVideo.buffers - prevStats->muxedVideo.buffers;
+        const guint64 bytes =
+            (stats.muxedVideo.bytes + stats.muxedAudio.bytes) -
+            (prevStats->muxedVideo.bytes + prevStats->muxedAudio.bytes);
+        json_object_set_new(object, "fps", json_real(double(videoFrames) * G_USEC_PER_SEC / interval));
+        json_object_set_new(object, "kbps", json_integer(bytes * 8 * 1000 / interval));
+    }
+
+    const GstClockTime latency = stats.latency.percentile(50);
+    json_object_set_new(
+        object,
+        "latency",
+        GST_CLOCK_TIME_IS_VALID(latency) ? json_integer(latency / GST_MSECOND) : json_null());
+
+    return object;
+}
+
+std::string Dump(json_t* json)
+{
+    g_auto(json_char_ptr) dump = json_dumps(json, JSON_COMPACT);
+    return dump ? dump : std::string();
+}
+
+std::string FormatEvent(guint64 seq, const char* type, const std::string& data)
+{
+    return "id: " + std::to_string(seq) + "\nevent: " + type + "\ndata: " + data + "\n\n";
+}
+
+}
+
+
+void StreamerEvents::update(
+    const std::shared_ptr<const ConfigSnapshot>& configSnapshot,
+    const std::shared_ptr<const StatsSnapshot>& statsSnapshot) noexcept
+{
+    bool hasSubscribers;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        hasSubscribers = _subscribers != 0;
+        if(!hasSubscribers) {
+            // the next subscriber waits for full state of the next tick
+            _history.clear();
+            _full.clear();
+        }
+    }
+
+    if(!hasSubscribers) {
+        _lastStates.clear();
+        _lastSerializedStats.clear();
+        _lastStats = statsSnapshot; // to calculate rates on the next tick
+        return;
+    }
+
+    const Config& config = configSnapshot->config;
+    const StatsSnapshot& stats = *statsSnapshot;
+    const gint64 interval = _lastStats ? stats.time - _lastStats->time : 0;
+
+    g_autoptr(json_t) changed = json_array();
+    g_autoptr(json_t) removed = json_array();
+    g_autoptr(json_t) changedStats = json_object();
+    g_autoptr(json_t) allStates = json_array();
+    g_autoptr(json_t) allStats = json_object();
+
+    std::map<std::string, std::string> states;
+    std::map<std::string, std::string> serializedStats;
+    for(const std::string& reStreamerId: config.reStreamersOrder) {
+        const auto configIt = config.reStreamers.find(reStreamerId);
+        if(configIt == config.reStreamers.end())
+            continue;
+
+        json_t* state = StateToJson(reStreamerId, configIt->second, stats);
+        std::string& serializedState = states[reStreamerId];
+        serializedState = Dump(state);
+
+        const auto lastStateIt = _lastStates.find(reStreamerId);
+        if(lastStateIt == _lastStates.end() || lastStateIt->second != serializedState)
+            json_array_append(changed, state);
+        json_array_append_new(allStates, state);
+
+        const auto statsIt = stats.reStreamers.find(reStreamerId);
+        if(statsIt != stats.reStreamers.end()) {
+            const ReStreamer::Stats* prevStats = nullptr;
+            if(_lastStats) {
+                const auto prevStatsIt = _lastStats->reStreamers.find(reStreamerId);
+                if(prevStatsIt != _lastStats->reStreamers.end())
+                    prevStats = &prevStatsIt->second;
+            }
+
+            json_t* streamerStats = StatsToJson(statsIt->second, prevStats, interval);
+            std::string& serializedStreamerStats = serializedStats[reStreamerId];
+            serializedStreamerStats = Dump(streamerStats);
+
+            const auto lastStatsIt = _lastSerializedStats.find(reStreamerId);
+            if(lastStatsIt == _lastSerializedStats.end() || lastStatsIt->second != serializedStreamerStats)
+                json_object_set(changedStats, reStreamerId.c_str(), streamerStats);
+            json_object_set_new(allStats, reStreamerId.c_str(), streamerStats);
+        }
+    }
+
+    for(const auto& [reStreamerId, state]: _lastStates) {
+        if(states.find(reStreamerId) == states.end())
+            json_array_append_new(removed, json_string(reStreamerId.c_str()));
+    }
+
+    // null stats - reStreamer is not running anymore
+    for(const auto& [reStreamerId, streamerStats]: _lastSerializedStats) {
+        if(serializedStats.find(reStreamerId) == serializedStats.end() &&
+            states.find(reStreamerId) != states.end())
+        {
+            json_object_set_new(changedStats, reStreamerId.c_str(), json_null());
+        }
+    }
+
+    g_autoptr(json_t) delta = json_object();
+    if(json_array_size(changed))
+        json_object_set(delta, "changed", changed);
+    if(json_array_size(removed))
+        json_object_set(delta, "removed", removed);
+    if(json_object_size(changedStats))
+        json_object_set(delta, "stats", changedStats);
+
+    _lastStates.swap(states);
+    _lastSerializedStats.swap(serializedStats);
+    _lastStats = statsSnapshot;
+
+    // full state is required anyway for subscribers came since the last tick
+    if(json_object_size(delta) == 0 && !_full.empty())
+        return;
+
+    g_autoptr(json_t) full = json_object();
+    json_object_set(full, "streamers", allStates);
+    json_object_set(full, "stats", allStats);
+
+    const std::string serializedDelta = Dump(delta);
+    const std::string serializedFull = Dump(full);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        ++_seq;
+        _history.emplace_back(_seq, FormatEvent(_seq, "delta", serializedDelta));
+        while(_history.size() > HistorySize)
+            _history.pop_front();
+        _full = FormatEvent(_seq, "full", serializedFull);
+    }
+
+    _updated.notify_all();
+}
+
+void StreamerEvents::subscribe() noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    ++_subscribers;
+}
+
+void StreamerEvents::unsubscribe() noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    assert(_subscribers > 0);
+    --_subscribers;
+}
+
+std::string StreamerEvents::next(guint64* cursor, std::chrono::milliseconds timeout) noexcept
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    const bool updated =
+        _updated.wait_for(
+            lock,
+            timeout,
+            [this, cursor] () {
+                return *cursor == 0 ? !_full.empty() : _seq > *cursor;
+            });
+    if(!updated)
+        return std::string();
+
+    std::string events;
+    if(*cursor == 0 || _history.empty() || _history.front().first > *cursor + 1) {
+        // new subscriber or too far behind
+        events = _full;
+    } else {
+        for(const auto& [seq, event]: _history) {
+            if(seq > *cursor)
+                events += event;
+        }
+    }
+
+    *cursor = _seq;
+
+    return events;
+}
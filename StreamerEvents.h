@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <glib.h>
+
+#include "ConfigPublisher.h"
+#include "StatsSnapshot.h"
+
+
+// Server-sent events stream of streamers state.
+// Main loop turns every stats tick into single coalesced delta event
+// with changed streamers only, serialized once and shared by all subscribers.
+// New or lagging subscribers get full state event instead of deltas.
+// Nothing is serialized while there are no subscribers.
+class StreamerEvents
+{
+public:
+    // has to be called from the main loop only
+    void update(
+        const std::shared_ptr<const ConfigSnapshot>&,
+        const std::shared_ptr<const StatsSnapshot>&) noexcept;
+
+    // thread safe.
+    // every subscribe() has to be paired with unsubscribe()
+    void subscribe() noexcept;
+    void unsubscribe() noexcept;
+
+    // thread safe.
+    // waits up to timeout for events newer than *cursor (0 - nothing received yet),
+    // returns them (already in SSE wire format) and moves *cursor forward.
+    // returns empty string on timeout
+    std::string next(guint64* cursor, std::chrono::milliseconds timeout) noexcept;
+
+private:
+    // accessed from the main loop only
+    std::map<std::string, std::string> _lastStates; // reStreamerId -> serialized state
+    std::map<std::string, std::string> _lastSerializedStats; // reStreamerId -> serialized stats
+    std::shared_ptr<const StatsSnapshot> _lastStats;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _updated;
+    unsigned _subscribers = 0;
+    guint64 _seq = 1; // 0 is reserved for subscribers without events
+    std::deque<std::pair<guint64, std::string>> _history; // seq -> delta event
+    // full state event as of _seq, empty until the first tick with subscribers.
+    // it's written from the main loop only
+    std::string _full;
+};
@@ -0,0 +1,85 @@
+#include "StreamerIndex.h"
+
+
+StreamerIndex::StreamerIndex(const Config& config)
+{
+    _ids.reserve(config.reStreamers.size());
+
+    for(const auto& [uniqueId, reStreamer]: config.reStreamers)
+        insert(reStreamer.sourceUrl, reStreamer.targetUrls, uniqueId);
+}
+
+// URLs can't contain '\0', so it's safe to use it as separator
+std::string StreamerIndex::Key(
+    const std::string_view& sourceUrl,
+    const std::deque<std::string>& targetUrls)
+{
+    std::string::size_type size = sourceUrl.size() + 1;
+    for(const std::string& targetUrl: targetUrls)
+        size += targetUrl.size() + 1;
+
+    std::string key;
+    key.reserve(size);
+
+    key += sourceUrl;
+    key += '\0';
+    for(const std::string& targetUrl: targetUrls) {
+        key += targetUrl;
+        key += '\0';
+    }
+
+    return key;
+}
+
+const std::string* StreamerIndex::find(
+    const std::string_view& sourceUrl,
+    const std::deque<std::string>& targetUrls) const
+{
+    const auto it = _ids.find(Key(sourceUrl, targetUrls));
+    if(it == _ids.end())
+        return nullptr;
+
+    return &it->second;
+}
+
+const std::string* StreamerIndex::findBySource(const std::string& sourceUrl) const
+{
+    const auto it = _sourceIds.find(sourceUrl);
+    if(it == _sourceIds.end())
+        return nullptr;
+
+    return &*it->second.begin();
+}
+
+bool StreamerIndex::insert(
+    const std::string_view& sourceUrl,
+    const std::deque<std::string>& targetUrls,
+    const std::string& uniqueId)
+{
+    if(!_ids.emplace(Key(sourceUrl, targetUrls), uniqueId).second)
+        return false;
+
+    _sourceIds[std::string(sourceUrl)].insert(uniqueId);
+
+    return true;
+}
+
+void StreamerIndex::erase(
+    const std::string_view& sourceUrl,
+    const std::deque<std::string>& targetUrls,
+    const std::string& uniqueId)
+{
+    const auto it = _ids.find(Key(sourceUrl, targetUrls));
+    if(it == _ids.end() || it->second != uniqueId)
+        return;
+
+    _ids.erase(it);
+
+    const auto sourceIt = _sourceIds.find(std::string(sourceUrl));
+    if(sourceIt == _sourceIds.end())
+        return;
+
+    sourceIt->second.erase(uniqueId);
+    if(sourceIt->second.empty())
+        _sourceIds.erase(sourceIt);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <set>
+#include <unordered_map>
+
+#include "Config.h"
+
+
+// Hashed (source, targets) -> reStreamer id lookup,
+// i.e. the key reStreamers are deduplicated and matched between configs by.
+// Also indexes reStreamers by source only.
+class StreamerIndex
+{
+public:
+    StreamerIndex() = default;
+    explicit StreamerIndex(const Config&);
+
+    // nullptr if not found
+    const std::string* find(
+        const std::string_view& sourceUrl,
+        const std::deque<std::string>& targetUrls) const;
+    // any reStreamer with the source, nullptr if source is not used
+    const std::string* findBySource(const std::string& sourceUrl) const;
+
+    // returns false if the same source and targets are already indexed
+    bool insert(
+        const std::string_view& sourceUrl,
+        const std::deque<std::string>& targetUrls,
+        const std::string& uniqueId);
+    // does nothing if the same source and targets are indexed for another reStreamer
+    void erase(
+        const std::string_view& sourceUrl,
+        const std::deque<std::string>& targetUrls,
+        const std::string& uniqueId);
+
+private:
+    static std::string Key(
+        const std::string_view& sourceUrl,
+        const std::deque<std::string>& targetUrls);
+
+private:
+    std::unordered_map<std::string, std::string> _ids;
+    std::unordered_map<std::string, std::set<std::string>> _sourceIds; // sourceUrl -> reStreamers ids
+};
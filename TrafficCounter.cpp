@@ -0,0 +1,33 @@
+#include "TrafficCounter.h"
+
+
+void TrafficCounter::attach(GstPad* pad) noexcept
+{
+    gst_pad_add_probe(
+        pad,
+        static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+        onProbe,
+        this,
+        nullptr);
+}
+
+// called from streaming thread
+GstPadProbeReturn TrafficCounter::onProbe(
+    GstPad*,
+    GstPadProbeInfo* info,
+    gpointer userData)
+{
+    TrafficCounter* self = static_cast<TrafficCounter*>(userData);
+
+    if(GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER) {
+        GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        self->_buffers += 1;
+        self->_bytes += gst_buffer_get_size(buffer);
+    } else if(GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList* list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        self->_buffers += gst_buffer_list_length(list);
+        self->_bytes += gst_buffer_list_calculate_size(list);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+
+#include <gst/gst.h>
+
+
+// Counts buffers passing through pad(s) with buffer probe.
+// Has to outlive pads it's attached to.
+class TrafficCounter
+{
+public:
+    struct Stats
+    {
+        guint64 buffers;
+        guint64 bytes;
+    };
+
+    void attach(GstPad*) noexcept;
+
+    Stats stats() const noexcept { return { _buffers, _bytes }; }
+
+private:
+    static GstPadProbeReturn onProbe(GstPad*, GstPadProbeInfo*, gpointer userData);
+
+private:
+    std::atomic<guint64> _buffers { 0 };
+    std::atomic<guint64> _bytes { 0 };
+};
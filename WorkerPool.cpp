@@ -0,0 +1,57 @@
+#include "WorkerPool.h"
+
+#include "Log.h"
+
+
+static const auto Log = ReStreamerLog;
+
+
+WorkerPool::WorkerPool(unsigned workersCount)
+{
+    for(unsigned i = 0; i < workersCount; ++i) {
+        GMainContext* context = g_main_context_new();
+        GMainLoop* loop = g_main_loop_new(context, FALSE);
+
+        _workers.emplace_back(Worker {
+            .context = context,
+            .loopPtr = GMainLoopPtr(loop),
+            .thread = std::thread(
+                [context, loop] () {
+                    g_main_context_push_thread_default(context);
+                    g_main_loop_run(loop);
+                    g_main_context_pop_thread_default(context);
+                }),
+        });
+    }
+
+    if(workersCount)
+        Log()->info("Pipelines bus handling is spread across {} worker threads", workersCount);
+}
+
+WorkerPool::~WorkerPool()
+{
+    auto quit =
+        [] (gpointer userData) -> gboolean {
+            g_main_loop_quit(static_cast<GMainLoop*>(userData));
+            return G_SOURCE_REMOVE;
+        };
+
+    for(Worker& worker: _workers) {
+        // invoked on worker context to not miss the loop not running yet
+        g_main_context_invoke(worker.context, GSourceFunc(quit), worker.loopPtr.get());
+        worker.thread.join();
+        worker.loopPtr.reset();
+        g_main_context_unref(worker.context);
+    }
+}
+
+GMainContext* WorkerPool::nextContext() noexcept
+{
+    if(_workers.empty())
+        return nullptr;
+
+    GMainContext* context = _workers[_nextWorker].context;
+    _nextWorker = (_nextWorker + 1) % _workers.size();
+
+    return context;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <deque>
+#include <thread>
+
+#include <glib.h>
+
+#include <CxxPtr/GlibPtr.h>
+
+
+// Threads with own GMainContext each
+// to take pipelines bus handling out of the main loop
+class WorkerPool
+{
+public:
+    explicit WorkerPool(unsigned workersCount);
+    ~WorkerPool();
+
+    // contexts are handed out round-robin.
+    // returns nullptr (i.e. default main context) if pool is empty
+    GMainContext* nextContext() noexcept;
+
+private:
+    struct Worker
+    {
+        GMainContext* context;
+        GMainLoopPtr loopPtr;
+        std::thread thread;
+    };
+
+    std::deque<Worker> _workers;
+    unsigned _nextWorker = 0;
+};
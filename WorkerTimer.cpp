@@ -0,0 +1,75 @@
+#include "WorkerTimer.h"
+
+#include <mutex>
+
+
+struct WorkerTimer::Timer
+{
+    Callback callback;
+
+    std::mutex mutex;
+    GSource* source = nullptr;
+    bool removed = false;
+};
+
+
+WorkerTimer::~WorkerTimer()
+{
+    remove();
+}
+
+void WorkerTimer::add(
+    GMainContext* context,
+    unsigned interval,
+    const Callback& callback) noexcept
+{
+    remove();
+
+    std::shared_ptr<Timer> timer = std::make_shared<Timer>();
+    timer->callback = callback;
+
+    auto onTimeout =
+        [] (gpointer userData) -> gboolean {
+            std::shared_ptr<Timer>& timer = *static_cast<std::shared_ptr<Timer>*>(userData);
+
+            // remove() waits for running callback to complete
+            std::lock_guard<std::mutex> lock(timer->mutex);
+            if(timer->removed)
+                return G_SOURCE_REMOVE;
+
+            timer->callback();
+
+            return G_SOURCE_CONTINUE;
+        };
+
+    GSource* source = g_timeout_source_new(interval);
+    g_source_set_callback(
+        source,
+        GSourceFunc(onTimeout),
+        new std::shared_ptr<Timer>(timer),
+        [] (gpointer userData) {
+            delete static_cast<std::shared_ptr<Timer>*>(userData);
+        });
+    timer->source = source;
+
+    _timer = timer;
+
+    g_source_attach(source, context);
+}
+
+void WorkerTimer::remove() noexcept
+{
+    if(!_timer)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_timer->mutex);
+        _timer->removed = true;
+    }
+
+    g_source_destroy(_timer->source);
+    g_source_unref(_timer->source);
+    _timer->source = nullptr;
+
+    _timer.reset();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <glib.h>
+
+
+// Periodic timer dispatched on (worker) context,
+// to keep per pipeline timers out of the main loop.
+// Has to be added/removed from the main context.
+class WorkerTimer
+{
+public:
+    // called on timer context
+    typedef std::function<void ()> Callback;
+
+    ~WorkerTimer();
+
+    void add(
+        GMainContext*, // nullptr - default main context
+        unsigned interval, // ms
+        const Callback&) noexcept;
+    // no callback is called after return,
+    // so it shouldn't be called from callback itself
+    void remove() noexcept;
+
+private:
+    struct Timer;
+
+    std::shared_ptr<Timer> _timer;
+};
@@ -0,0 +1,43 @@
+#include "BenchStreams.h"
+
+
+void AddBenchReStreamer(
+    Config* config,
+    const std::string& uniqueId,
+    const std::string& sourceUrl,
+    const std::string& targetUrl)
+{
+    config->reStreamers.emplace(
+        uniqueId,
+        Config::ReStreamer {
+            .sourceUrl = sourceUrl,
+            .targetUrls = { targetUrl },
+            .enabled = true,
+        });
+    config->reStreamersOrder.push_back(uniqueId);
+}
+
+BenchTotals CollectBenchTotals(const StreamerControl& control)
+{
+    const std::map<std::string, ReStreamer::Stats> stats = control.stats();
+
+    BenchTotals totals {
+        .reStreamers = static_cast<unsigned>(stats.size()),
+        .streaming = 0,
+        .ingests = static_cast<unsigned>(control.ingestsCount()),
+        .sentBytes = 0,
+        .restarts = 0,
+    };
+
+    for(const auto& pair: stats) {
+        if(pair.second.streaming)
+            ++totals.streaming;
+        for(const RTMPTarget::Stats& targetStats: pair.second.targets)
+            totals.sentBytes += targetStats.sentBytes;
+    }
+
+    for(const auto& pair: control.restartStates())
+        totals.restarts += pair.second.restarts;
+
+    return totals;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+#include <glib.h>
+
+#include "Config.h"
+#include "StreamerControl.h"
+
+
+// Benchmarks run reStreamers through StreamerControl,
+// i.e. with the same start path, restart scheduler and config changes handling
+// application uses.
+
+// appends enabled reStreamer to config
+void AddBenchReStreamer(
+    Config*,
+    const std::string& uniqueId,
+    const std::string& sourceUrl,
+    const std::string& targetUrl);
+
+struct BenchTotals
+{
+    unsigned reStreamers; // running
+    unsigned streaming; // source video is sent to targets
+    unsigned ingests;
+    guint64 sentBytes; // by targets of running reStreamers
+    unsigned restarts; // reStreamers, sources and targets restarts
+};
+
+BenchTotals CollectBenchTotals(const StreamerControl&);
@@ -0,0 +1,169 @@
+// Measures LoadConfig time and memory on generated configs with a lot of streamers.
+//
+// Usage: ConfigLoadBenchmark [streamers count...]
+// Every count is loaded in own forked process to get clean peak memory,
+// results are printed one JSON object per line.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <deque>
+#include <chrono>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "Log.h"
+#include "ConfigHelpers.h"
+#include "ConfigLoader.h"
+
+#include "ProcessStats.h"
+
+
+namespace {
+
+const unsigned DefaultCounts[] = { 10000, 100000 };
+
+bool GenerateConfig(const std::string& path, unsigned count)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file)
+        return false;
+
+    fprintf(file, "streamers: (\n");
+    for(unsigned i = 0; i < count; ++i) {
+        fprintf(
+            file,
+            "  {\n"
+            "    source: \"rtsp://127.0.0.1:8554/camera%u\"\n"
+            "    description: \"Camera %u\"\n"
+            "    target: \"rtmp://127.0.0.1/live/{key}\"\n"
+            "    key: \"key%u\"\n"
+            "  }%s\n",
+            i, i, i,
+            i + 1 < count ? "," : "");
+    }
+    fprintf(file, ")\n");
+
+    return fclose(file) == 0;
+}
+
+void RemoveDir(const gchar* path)
+{
+    if(GDir* dir = g_dir_open(path, 0, nullptr)) {
+        while(const gchar* name = g_dir_read_name(dir)) {
+            g_autofree gchar* filePath = g_build_filename(path, name, nullptr);
+            g_unlink(filePath);
+        }
+        g_dir_close(dir);
+    }
+
+    g_rmdir(path);
+}
+
+double LoadMs(unsigned expectedCount, Config* config, bool* appConfigOutdated)
+{
+    http::Config httpConfig;
+    signalling::Config wsConfig;
+
+    const auto begin = std::chrono::steady_clock::now();
+    const bool loaded = LoadConfig(&httpConfig, &wsConfig, config, appConfigOutdated);
+    const auto end = std::chrono::steady_clock::now();
+
+    if(!loaded || config->reStreamers.size() != expectedCount) {
+        fprintf(stderr, "Loaded %zu streamers of %u\n", config->reStreamers.size(), expectedCount);
+        exit(EXIT_FAILURE);
+    }
+
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// runs in forked process since glib caches config dirs on first use
+void Run(const std::string& configDir, unsigned count)
+{
+    g_setenv("XDG_CONFIG_HOME", configDir.c_str(), TRUE);
+    g_setenv("XDG_CONFIG_DIRS", (configDir + "/none").c_str(), TRUE);
+
+    InitReStreamerLogger(spdlog::level::warn);
+
+    const std::deque<std::string> configDirs = ConfigDirs();
+    if(configDirs.empty() || !GenerateConfig(UserConfigPath(configDirs.back()), count)) {
+        fprintf(stderr, "Failed to generate config in \"%s\"\n", configDir.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    const unsigned long baseRss = ReadProcessStatus("VmRSS");
+
+    // without app config, i.e. the first launch
+    bool appConfigOutdated = false;
+    double firstLoadMs;
+    double saveMs;
+    {
+        Config config;
+        firstLoadMs = LoadMs(count, &config, &appConfigOutdated);
+
+        const auto begin = std::chrono::steady_clock::now();
+        SaveAppConfig(config);
+        const auto end = std::chrono::steady_clock::now();
+        saveMs = std::chrono::duration<double, std::milli>(end - begin).count();
+    }
+
+    // ids are taken from app config
+    Config config;
+    const double loadMs = LoadMs(count, &config, &appConfigOutdated);
+
+    printf(
+        "{\"streamers\": %u, \"first_load_ms\": %.1f, \"save_ms\": %.1f, \"load_ms\": %.1f, "
+        "\"app_config_outdated\": %s, \"base_rss_kb\": %lu, \"peak_rss_kb\": %lu}\n",
+        count,
+        firstLoadMs,
+        saveMs,
+        loadMs,
+        appConfigOutdated ? "true" : "false",
+        baseRss,
+        ReadProcessStatus("VmHWM"));
+    fflush(stdout);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::deque<unsigned> counts;
+    for(int i = 1; i < argc; ++i) {
+        const unsigned long count = strtoul(argv[i], nullptr, 10);
+        if(count == 0) {
+            fprintf(stderr, "Usage: %s [streamers count...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        counts.push_back(count);
+    }
+    if(counts.empty())
+        counts.assign(std::begin(DefaultCounts), std::end(DefaultCounts));
+
+    bool success = true;
+    for(unsigned count: counts) {
+        g_autofree gchar* configDir = g_dir_make_tmp("ConfigLoadBenchmark-XXXXXX", nullptr);
+        if(!configDir) {
+            fprintf(stderr, "Failed to create temporary directory\n");
+            return EXIT_FAILURE;
+        }
+
+        const pid_t pid = fork();
+        if(pid == 0) {
+            Run(configDir, count);
+            _exit(EXIT_SUCCESS);
+        }
+
+        int status = 0;
+        if(pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            success = false;
+
+        RemoveDir(configDir);
+    }
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,424 @@
+// Measures glass-to-glass latency of reStreaming.
+//
+// Usage: LatencyBenchmark [--load COUNT] [--max-p99 MS] [--warmup SECONDS] [--duration SECONDS] [--workers COUNT]
+// Synthetic source embeds clock time into every video frame,
+// measured reStreamer writes FLV into FIFO and the time is read back
+// from FLV video tags as soon as they leave the target.
+// Latency is measured idle (the only stream) and loaded (with other streams running),
+// each in own forked process, results are printed one JSON object per line.
+// Exits with failure if p99 latency of any run exceeds the threshold.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include "Log.h"
+
+#include "SyntheticSource.h"
+#include "BenchStreams.h"
+#include "Timecode.h"
+
+
+namespace {
+
+enum {
+    STARTUP_TIMEOUT = 120, // seconds for all streams to become live
+    TICK_INTERVAL = 1, // seconds
+    POLL_TIMEOUT = 100, // ms
+    FLV_HEADER_SIZE = 9 + 4, // with the first PreviousTagSize
+    FLV_TAG_HEADER_SIZE = 11,
+    FLV_TAG_AUDIO = 8,
+    FLV_TAG_VIDEO = 9,
+    FLV_TAG_SCRIPT = 18,
+    FLV_CODEC_AVC = 7,
+    FLV_AVC_NALU = 1,
+};
+
+const char* const LoadTargetUrl = "file:///dev/null";
+const char* const MeasuredId = "measured";
+
+struct Options
+{
+    gint load = 100; // streams running along with measured one
+    gint maxP99 = 3000; // ms
+    gint warmup = 10; // seconds after all streams are live
+    gint duration = 30; // seconds
+    gint workers = 2;
+};
+
+// Reads FLV written by target into FIFO
+// and collects latency of timecoded video frames
+class FlvCapture
+{
+public:
+    explicit FlvCapture(const std::string& fifoPath);
+    ~FlvCapture();
+
+    // has to be opened before target to not block it
+    bool open() noexcept;
+    void setRecording(bool recording) { _recording = recording; }
+    void stop() noexcept;
+
+    // ms
+    std::vector<double> latencies() const;
+    unsigned tagsWithoutTimecode() const { return _tagsWithoutTimecode; }
+
+private:
+    void run() noexcept;
+    void parse() noexcept;
+
+private:
+    const std::string _fifoPath;
+    int _fd = -1;
+    std::thread _thread;
+    std::atomic<bool> _stop { false };
+    std::atomic<bool> _recording { false };
+
+    std::vector<guint8> _data; // accessed from capture thread only
+    std::atomic<unsigned> _tagsWithoutTimecode { 0 };
+
+    mutable std::mutex _latenciesMutex;
+    std::vector<double> _latencies;
+};
+
+FlvCapture::FlvCapture(const std::string& fifoPath) :
+    _fifoPath(fifoPath)
+{
+}
+
+FlvCapture::~FlvCapture()
+{
+    stop();
+}
+
+bool FlvCapture::open() noexcept
+{
+    if(mkfifo(_fifoPath.c_str(), 0600) != 0)
+        return false;
+
+    // non blocking open doesn't wait for writer
+    _fd = ::open(_fifoPath.c_str(), O_RDONLY | O_NONBLOCK);
+    if(_fd < 0)
+        return false;
+
+    _thread = std::thread([this] () { run(); });
+
+    return true;
+}
+
+void FlvCapture::stop() noexcept
+{
+    _stop = true;
+    if(_thread.joinable())
+        _thread.join();
+
+    if(_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+
+    g_unlink(_fifoPath.c_str());
+}
+
+void FlvCapture::run() noexcept
+{
+    guint8 chunk[64 * 1024];
+    while(!_stop) {
+        struct pollfd pollFd = { .fd = _fd, .events = POLLIN };
+        if(poll(&pollFd, 1, POLL_TIMEOUT) <= 0)
+            continue;
+
+        const ssize_t size = read(_fd, chunk, sizeof(chunk));
+        if(size > 0) {
+            _data.insert(_data.end(), chunk, chunk + size);
+            parse();
+        } else if(size == 0 || errno != EAGAIN) {
+            // target disconnected, the next connection starts from new tag
+            _data.clear();
+            g_usleep(POLL_TIMEOUT * 1000);
+        }
+    }
+}
+
+void FlvCapture::parse() noexcept
+{
+    gsize offset = 0;
+    if(_data.size() >= 3 && memcmp(_data.data(), "FLV", 3) == 0) {
+        if(_data.size() < FLV_HEADER_SIZE)
+            return;
+        offset = FLV_HEADER_SIZE;
+    }
+
+    while(_data.size() - offset >= FLV_TAG_HEADER_SIZE) {
+        const guint8* tag = _data.data() + offset;
+        const guint8 tagType = tag[0] & 0x1f;
+        if(tagType != FLV_TAG_AUDIO && tagType != FLV_TAG_VIDEO && tagType != FLV_TAG_SCRIPT) {
+            fprintf(stderr, "Unexpected FLV tag type %u. Captured data dropped.\n", tagType);
+            _data.clear();
+            return;
+        }
+
+        const gsize dataSize = GST_READ_UINT24_BE(tag + 1);
+        const gsize tagSize = FLV_TAG_HEADER_SIZE + dataSize + 4; // with PreviousTagSize
+        if(_data.size() - offset < tagSize)
+            break;
+
+        const guint8* tagData = tag + FLV_TAG_HEADER_SIZE;
+        if(tagType == FLV_TAG_VIDEO && dataSize > 5 &&
+            (tagData[0] & 0x0f) == FLV_CODEC_AVC && tagData[1] == FLV_AVC_NALU)
+        {
+            const GstClockTime timecode = FindTimecode(tagData + 5, dataSize - 5);
+            if(!GST_CLOCK_TIME_IS_VALID(timecode)) {
+                ++_tagsWithoutTimecode;
+            } else if(_recording) {
+                const GstClockTimeDiff latency = GST_CLOCK_DIFF(timecode, TimecodeNow());
+                std::lock_guard lock(_latenciesMutex);
+                _latencies.push_back(static_cast<double>(latency) / GST_MSECOND);
+            }
+        }
+
+        offset += tagSize;
+    }
+
+    _data.erase(_data.begin(), _data.begin() + offset);
+}
+
+std::vector<double> FlvCapture::latencies() const
+{
+    std::lock_guard lock(_latenciesMutex);
+    return _latencies;
+}
+
+struct Run
+{
+    const Options* options;
+    unsigned count; // including measured stream
+    GMainLoop* loop;
+    StreamerControl* control;
+    FlvCapture* capture;
+
+    gint64 startTime; // monotonic time
+    gint64 measureTime = 0; // monotonic time the next phase starts at
+    bool recording = false;
+};
+
+// sorted has to be not empty
+double Percentile(const std::vector<double>& sorted, double percentile)
+{
+    const size_t rank = static_cast<size_t>(std::ceil(percentile / 100 * sorted.size()));
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// runs in forked process to not share GStreamer state between runs
+bool RunScenario(
+    const Options& options,
+    const SyntheticSource& source,
+    const char* scenario,
+    unsigned load)
+{
+    gst_init(nullptr, nullptr);
+    InitReStreamerLogger(spdlog::level::warn);
+
+    // target shouldn't be killed if capture is gone
+    signal(SIGPIPE, SIG_IGN);
+
+    g_autofree gchar* captureDir = g_dir_make_tmp("LatencyBenchmark-XXXXXX", nullptr);
+    if(!captureDir) {
+        fprintf(stderr, "Failed to create temporary directory\n");
+        return false;
+    }
+
+    g_autofree gchar* fifoPath = g_build_filename(captureDir, "capture.flv", nullptr);
+    g_autofree gchar* fifoUri = g_filename_to_uri(fifoPath, nullptr, nullptr);
+    FlvCapture capture(fifoPath);
+    if(!capture.open()) {
+        fprintf(stderr, "Failed to open FIFO \"%s\"\n", fifoPath);
+        g_rmdir(captureDir);
+        return false;
+    }
+
+    Config config;
+    config.workerThreads = options.workers;
+    AddBenchReStreamer(&config, MeasuredId, source.url(0), fifoUri);
+    for(unsigned i = 1; i <= load; ++i) {
+        g_autofree gchar* id = g_strdup_printf("%u", i);
+        AddBenchReStreamer(&config, id, source.url(i), LoadTargetUrl);
+    }
+
+    GMainLoop* loop = g_main_loop_new(nullptr, FALSE);
+    auto control = std::make_unique<StreamerControl>(config, StreamerControl::SourceRemoved());
+
+    Run run {
+        .options = &options,
+        .count = load + 1,
+        .loop = loop,
+        .control = control.get(),
+        .capture = &capture,
+        .startTime = g_get_monotonic_time(),
+    };
+
+    control->admitReStreamers();
+
+    auto tick =
+        [] (gpointer userData) -> gboolean {
+            Run* run = static_cast<Run*>(userData);
+            const gint64 now = g_get_monotonic_time();
+
+            if(!run->measureTime) {
+                const bool allLive = CollectBenchTotals(*run->control).streaming == run->count;
+                if(allLive || now - run->startTime >= STARTUP_TIMEOUT * G_USEC_PER_SEC) {
+                    if(!allLive)
+                        fprintf(stderr, "Not all streams are live after %u seconds\n", STARTUP_TIMEOUT);
+
+                    run->measureTime = now + run->options->warmup * G_USEC_PER_SEC;
+                }
+
+                return G_SOURCE_CONTINUE;
+            }
+
+            if(now < run->measureTime)
+                return G_SOURCE_CONTINUE;
+
+            if(!run->recording) {
+                run->recording = true;
+                run->capture->setRecording(true);
+                run->measureTime = now + run->options->duration * G_USEC_PER_SEC;
+                return G_SOURCE_CONTINUE;
+            }
+
+            run->capture->setRecording(false);
+            g_main_loop_quit(run->loop);
+            return G_SOURCE_REMOVE;
+        };
+    g_timeout_add_seconds(TICK_INTERVAL, GSourceFunc(tick), &run);
+
+    g_main_loop_run(loop);
+
+    const BenchTotals totals = CollectBenchTotals(*control);
+
+    control.reset();
+    capture.stop();
+    g_rmdir(captureDir);
+
+    std::vector<double> latencies = capture.latencies();
+    if(latencies.empty()) {
+        fprintf(
+            stderr,
+            "No timecoded frames were captured in \"%s\" run (%u video tags without timecode)\n",
+            scenario,
+            capture.tagsWithoutTimecode());
+        return false;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    double sum = 0;
+    for(double latency: latencies)
+        sum += latency;
+
+    const double p99 = Percentile(latencies, 99);
+    const bool passed = p99 <= options.maxP99;
+
+    printf(
+        "{\"scenario\": \"%s\", \"streams\": %u, \"streaming\": %u, \"audio\": %s, \"frames\": %zu, "
+        "\"min_ms\": %.1f, \"mean_ms\": %.1f, \"p50_ms\": %.1f, \"p90_ms\": %.1f, \"p99_ms\": %.1f, "
+        "\"max_ms\": %.1f, \"max_p99_ms\": %d, \"restarts\": %u, \"passed\": %s}\n",
+        scenario,
+        run.count,
+        totals.streaming,
+        source.hasAudio() ? "true" : "false",
+        latencies.size(),
+        latencies.front(),
+        sum / latencies.size(),
+        Percentile(latencies, 50),
+        Percentile(latencies, 90),
+        p99,
+        latencies.back(),
+        options.maxP99,
+        totals.restarts,
+        passed ? "true" : "false");
+    fflush(stdout);
+
+    if(!passed)
+        fprintf(stderr, "p99 latency of \"%s\" run %.1f ms exceeds %d ms\n", scenario, p99, options.maxP99);
+
+    return passed;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    GOptionEntry optionEntries[] = {
+        { "load", 'l', 0, G_OPTION_ARG_INT, &options.load,
+            "Streams running along with measured one in loaded run", "COUNT" },
+        { "max-p99", 0, 0, G_OPTION_ARG_INT, &options.maxP99,
+            "Fail if p99 latency exceeds it", "MS" },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &options.warmup,
+            "Seconds to wait after all streams are live", "SECONDS" },
+        { "duration", 'd', 0, G_OPTION_ARG_INT, &options.duration,
+            "Seconds to measure", "SECONDS" },
+        { "workers", 0, 0, G_OPTION_ARG_INT, &options.workers,
+            "Threads for pipelines bus handling", "COUNT" },
+        { nullptr }
+    };
+
+    g_autoptr(GOptionContext) optionContext = g_option_context_new(nullptr);
+    g_option_context_add_main_entries(optionContext, optionEntries, nullptr);
+    g_autoptr(GError) error = nullptr;
+    if(!g_option_context_parse(optionContext, &argc, &argv, &error) ||
+        options.load < 0 || options.maxP99 <= 0 ||
+        options.warmup < 0 || options.duration <= 0 || options.workers < 0)
+    {
+        fprintf(stderr, "%s\n", error ? error->message : "Wrong option value");
+        return EXIT_FAILURE;
+    }
+
+    // has to be forked before any GStreamer usage
+    SyntheticSource source(
+        SyntheticSource::Options {
+            .mounts = static_cast<unsigned>(options.load) + 1,
+            .timecode = true,
+        });
+    if(!source.start()) {
+        fprintf(stderr, "Failed to start synthetic source\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::pair<const char*, unsigned>> scenarios = { { "idle", 0 } };
+    if(options.load > 0)
+        scenarios.emplace_back("loaded", options.load);
+
+    bool success = true;
+    for(const auto& [scenario, load]: scenarios) {
+        const pid_t pid = fork();
+        if(pid == 0)
+            _exit(RunScenario(options, source, scenario, load) ? EXIT_SUCCESS : EXIT_FAILURE);
+
+        int status = 0;
+        if(pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            success = false;
+    }
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
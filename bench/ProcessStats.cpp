@@ -0,0 +1,79 @@
+#include "ProcessStats.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+
+namespace {
+
+unsigned long CountOpenFds() noexcept
+{
+    GDir* dir = g_dir_open("/proc/self/fd", 0, nullptr);
+    if(!dir)
+        return 0;
+
+    unsigned long count = 0;
+    while(g_dir_read_name(dir))
+        ++count;
+
+    g_dir_close(dir);
+
+    return count > 0 ? count - 1 : 0; // fd of the dir itself
+}
+
+}
+
+unsigned long ReadProcessStatus(const char* name) noexcept
+{
+    FILE* status = fopen("/proc/self/status", "r");
+    if(!status)
+        return 0;
+
+    const size_t nameLength = strlen(name);
+    unsigned long value = 0;
+    char line[256];
+    while(fgets(line, sizeof(line), status)) {
+        if(strncmp(line, name, nameLength) == 0 && line[nameLength] == ':') {
+            value = strtoul(line + nameLength + 1, nullptr, 10);
+            break;
+        }
+    }
+
+    fclose(status);
+
+    return value;
+}
+
+ProcessStats SampleProcessStats() noexcept
+{
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 heap = mallinfo2();
+    const unsigned long heapInUse = (heap.uordblks + heap.hblkhd) / 1024;
+    const unsigned long heapFree = heap.fordblks / 1024;
+#else
+    const unsigned long heapInUse = 0;
+    const unsigned long heapFree = 0;
+#endif
+
+    auto seconds =
+        [] (const struct timeval& time) {
+            return time.tv_sec + time.tv_usec / 1000000.;
+        };
+
+    return ProcessStats {
+        .time = g_get_monotonic_time(),
+        .cpuTime = seconds(usage.ru_utime) + seconds(usage.ru_stime),
+        .rss = ReadProcessStatus("VmRSS"),
+        .threads = ReadProcessStatus("Threads"),
+        .fds = CountOpenFds(),
+        .heapInUse = heapInUse,
+        .heapFree = heapFree,
+    };
+}
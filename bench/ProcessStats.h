@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glib.h>
+
+
+// Resources used by the current process, taken from procfs
+struct ProcessStats
+{
+    gint64 time; // monotonic time (us) stats were taken at
+    double cpuTime; // seconds of user + system time
+    unsigned long rss; // kB
+    unsigned long threads;
+    unsigned long fds;
+    unsigned long heapInUse; // kB allocated by malloc, 0 if unknown
+    unsigned long heapFree; // kB of free chunks kept by malloc, 0 if unknown
+};
+
+ProcessStats SampleProcessStats() noexcept;
+
+// returns value of the field from /proc/self/status (kB for memory fields), 0 if unknown
+unsigned long ReadProcessStatus(const char* name) noexcept;
@@ -0,0 +1,225 @@
+// Measures resources used by reStreamers depending on the number of streams.
+//
+// Usage: ScaleBenchmark [--warmup SECONDS] [--duration SECONDS] [--workers COUNT] [streams count...]
+// Every stream pulls own synthetic H.264 + AAC source from local RTSP server
+// and sends FLV to "file:///dev/null", so neither encoding nor RTMP server is measured.
+// Streams are admitted and restarted by application control plane (StreamerControl),
+// so startup time includes restart scheduler start slots throttling.
+// Every count is run in own forked process to get clean process stats,
+// results are printed one JSON object per line.
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <algorithm>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gst/gst.h>
+
+#include "Log.h"
+
+#include "ProcessStats.h"
+#include "SyntheticSource.h"
+#include "BenchStreams.h"
+
+
+namespace {
+
+enum {
+    STARTUP_TIMEOUT = 120, // seconds for all streams to become live
+    TICK_INTERVAL = 1, // seconds
+};
+
+const unsigned DefaultCounts[] = { 1, 10, 100, 1000 };
+
+const char* const TargetUrl = "file:///dev/null";
+
+struct Options
+{
+    gint warmup = 10; // seconds after all streams are live
+    gint duration = 30; // seconds
+    gint workers = 2;
+};
+
+struct Run
+{
+    const Options* options;
+    unsigned count;
+    GMainLoop* loop;
+    StreamerControl* control;
+
+    gint64 startTime; // monotonic time
+    gint64 startupDuration = -1; // us, -1 - not all streams are live
+    gint64 measureTime = 0; // monotonic time measurement starts at
+    ProcessStats baseStats;
+    ProcessStats beginStats;
+    BenchTotals beginTotals;
+};
+
+void PrintResults(
+    const Run& run,
+    const ProcessStats& endStats,
+    const BenchTotals& endTotals,
+    bool hasAudio)
+{
+    const double duration = (endStats.time - run.beginStats.time) / 1000000.;
+    const double cpuPercent = (endStats.cpuTime - run.beginStats.cpuTime) / duration * 100;
+    const double throughput = (endTotals.sentBytes - run.beginTotals.sentBytes) * 8 / duration / 1000;
+
+    printf(
+        "{\"streams\": %u, \"audio\": %s, \"streaming\": %u, \"startup_s\": %.1f, \"duration_s\": %.1f, "
+        "\"cpu_percent\": %.1f, \"cpu_percent_per_stream\": %.3f, "
+        "\"rss_kb\": %lu, \"rss_kb_per_stream\": %.1f, \"threads\": %lu, \"fds\": %lu, "
+        "\"throughput_kbps\": %.1f, \"throughput_kbps_per_stream\": %.1f, \"restarts\": %u}\n",
+        run.count,
+        hasAudio ? "true" : "false",
+        endTotals.streaming,
+        run.startupDuration < 0 ? -1. : run.startupDuration / 1000000.,
+        duration,
+        cpuPercent,
+        cpuPercent / run.count,
+        endStats.rss,
+        (static_cast<double>(endStats.rss) - run.baseStats.rss) / run.count,
+        endStats.threads,
+        endStats.fds,
+        throughput,
+        throughput / run.count,
+        endTotals.restarts - run.beginTotals.restarts);
+    fflush(stdout);
+}
+
+// runs in forked process to not share GStreamer state between counts
+bool RunCount(const Options& options, const SyntheticSource& source, unsigned count)
+{
+    gst_init(nullptr, nullptr);
+    InitReStreamerLogger(spdlog::level::warn);
+
+    Config config;
+    config.workerThreads = options.workers;
+    for(unsigned i = 0; i < count; ++i) {
+        g_autofree gchar* id = g_strdup_printf("%u", i);
+        AddBenchReStreamer(&config, id, source.url(i), TargetUrl);
+    }
+
+    GMainLoop* loop = g_main_loop_new(nullptr, FALSE);
+    StreamerControl control(config, StreamerControl::SourceRemoved());
+
+    Run run {
+        .options = &options,
+        .count = count,
+        .loop = loop,
+        .control = &control,
+        .startTime = g_get_monotonic_time(),
+        .baseStats = SampleProcessStats(),
+    };
+
+    // startup goes through restart scheduler start slots the same way as on application start
+    control.admitReStreamers();
+
+    auto tick =
+        [] (gpointer userData) -> gboolean {
+            Run* run = static_cast<Run*>(userData);
+            const gint64 now = g_get_monotonic_time();
+
+            if(!run->measureTime) {
+                const bool allLive = CollectBenchTotals(*run->control).streaming == run->count;
+                if(allLive)
+                    run->startupDuration = now - run->startTime;
+
+                if(allLive || now - run->startTime >= STARTUP_TIMEOUT * G_USEC_PER_SEC) {
+                    if(!allLive)
+                        fprintf(stderr, "Not all streams are live after %u seconds\n", STARTUP_TIMEOUT);
+
+                    run->measureTime = now + run->options->warmup * G_USEC_PER_SEC;
+                }
+
+                return G_SOURCE_CONTINUE;
+            }
+
+            if(now < run->measureTime)
+                return G_SOURCE_CONTINUE;
+
+            if(run->beginStats.time == 0) {
+                run->beginStats = SampleProcessStats();
+                run->beginTotals = CollectBenchTotals(*run->control);
+                run->measureTime = now + run->options->duration * G_USEC_PER_SEC;
+                return G_SOURCE_CONTINUE;
+            }
+
+            g_main_loop_quit(run->loop);
+            return G_SOURCE_REMOVE;
+        };
+    g_timeout_add_seconds(TICK_INTERVAL, GSourceFunc(tick), &run);
+
+    g_main_loop_run(loop);
+
+    const ProcessStats endStats = SampleProcessStats();
+    const BenchTotals endTotals = CollectBenchTotals(control);
+    PrintResults(run, endStats, endTotals, source.hasAudio());
+
+    return endTotals.streaming > 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    GOptionEntry optionEntries[] = {
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &options.warmup,
+            "Seconds to wait after all streams are live", "SECONDS" },
+        { "duration", 'd', 0, G_OPTION_ARG_INT, &options.duration,
+            "Seconds to measure", "SECONDS" },
+        { "workers", 0, 0, G_OPTION_ARG_INT, &options.workers,
+            "Threads for pipelines bus handling", "COUNT" },
+        { nullptr }
+    };
+
+    g_autoptr(GOptionContext) optionContext = g_option_context_new("[streams count...]");
+    g_option_context_add_main_entries(optionContext, optionEntries, nullptr);
+    g_autoptr(GError) error = nullptr;
+    if(!g_option_context_parse(optionContext, &argc, &argv, &error) ||
+        options.warmup < 0 || options.duration <= 0 || options.workers < 0)
+    {
+        fprintf(stderr, "%s\n", error ? error->message : "Wrong option value");
+        return EXIT_FAILURE;
+    }
+
+    std::deque<unsigned> counts;
+    for(int i = 1; i < argc; ++i) {
+        const unsigned long count = strtoul(argv[i], nullptr, 10);
+        if(count == 0) {
+            fprintf(stderr, "Wrong streams count \"%s\"\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        counts.push_back(count);
+    }
+    if(counts.empty())
+        counts.assign(std::begin(DefaultCounts), std::end(DefaultCounts));
+
+    unsigned maxCount = 0;
+    for(unsigned count: counts)
+        maxCount = std::max(maxCount, count);
+
+    // has to be forked before any GStreamer usage
+    SyntheticSource source(SyntheticSource::Options { .mounts = maxCount });
+    if(!source.start()) {
+        fprintf(stderr, "Failed to start synthetic source\n");
+        return EXIT_FAILURE;
+    }
+
+    bool success = true;
+    for(unsigned count: counts) {
+        const pid_t pid = fork();
+        if(pid == 0)
+            _exit(RunCount(options, source, count) ? EXIT_SUCCESS : EXIT_FAILURE);
+
+        int status = 0;
+        if(pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            success = false;
+    }
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
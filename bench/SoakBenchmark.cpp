@@ -0,0 +1,354 @@
+// Long-run soak of reStreamers restart churn to catch leaks and heap fragmentation.
+//
+// Usage: SoakBenchmark [--streams COUNT] [--duration SECONDS] [--drop-interval SECONDS]
+//                      [--toggles COUNT] [--sample-interval SECONDS] [--warmup SECONDS]
+//                      [--max-rss-growth KB] [--max-object-growth COUNT] ...
+// Synthetic source disconnects all clients every drop interval (source failures),
+// and every second random reStreamers are disabled or enabled back
+// with the same config changes REST API posts to application control plane (StreamerControl).
+// RSS, heap usage, fd and thread count and live GstObject count
+// (with leaks tracer) are printed one JSON object per sample,
+// followed by summary comparing the first and the last quarter of samples after warmup.
+// Exits with failure if leak or fragmentation is detected.
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+
+#include <gst/gst.h>
+
+#include "Log.h"
+
+#include "ProcessStats.h"
+#include "SyntheticSource.h"
+#include "BenchStreams.h"
+
+
+namespace {
+
+enum {
+    TOGGLE_INTERVAL = 1, // seconds
+    MIN_SAMPLES = 8, // after warmup, to compare quarters
+};
+
+const char* const TargetUrl = "file:///dev/null";
+
+struct Options
+{
+    gint streams = 50;
+    gint duration = 3600; // seconds
+    gint warmup = 120; // seconds before samples are taken into account
+    gint dropInterval = 5; // seconds between source failures
+    gint toggles = 5; // reStreamers disabled/enabled per second
+    gint sampleInterval = 10; // seconds
+    gint maxRssGrowth = 16384; // kB
+    gint maxObjectGrowth = 200;
+    gint maxFdGrowth = 16;
+    gint maxThreadGrowth = 8;
+    gint workers = 2;
+};
+
+struct Sample
+{
+    ProcessStats stats;
+    gint64 gstObjects; // -1 if unknown
+    gint64 gstMiniObjects; // -1 if unknown
+};
+
+struct Soak
+{
+    const Options* options;
+    GMainLoop* loop;
+    StreamerControl* control;
+    GstTracer* leaksTracer; // nullptr if not active
+
+    gint64 startTime; // monotonic time
+    guint64 cycles = 0; // disable/enable cycles
+    std::deque<Sample> samples; // after warmup
+};
+
+GstTracer* FindLeaksTracer()
+{
+    GstTracer* leaksTracer = nullptr;
+
+    GList* tracers = gst_tracing_get_active_tracers();
+    for(GList* tracer = tracers; tracer; tracer = tracer->next) {
+        if(!leaksTracer && g_str_equal(G_OBJECT_TYPE_NAME(tracer->data), "GstLeaksTracer"))
+            leaksTracer = GST_TRACER(gst_object_ref(tracer->data));
+    }
+    g_list_free_full(tracers, gst_object_unref);
+
+    return leaksTracer;
+}
+
+void CountLiveObjects(GstTracer* leaksTracer, gint64* objects, gint64* miniObjects)
+{
+    *objects = -1;
+    *miniObjects = -1;
+
+    if(!leaksTracer)
+        return;
+
+    GstStructure* liveObjects = nullptr;
+    g_signal_emit_by_name(leaksTracer, "get-live-objects", &liveObjects);
+    if(!liveObjects)
+        return;
+
+    *objects = 0;
+    *miniObjects = 0;
+
+    const GValue* list = gst_structure_get_value(liveObjects, "live-objects-list");
+    const guint size = list ? gst_value_list_get_size(list) : 0;
+    for(guint i = 0; i < size; ++i) {
+        const GstStructure* info =
+            gst_value_get_structure(gst_value_list_get_value(list, i));
+        const GValue* object = gst_structure_get_value(info, "object");
+        if(object && G_VALUE_HOLDS(object, GST_TYPE_OBJECT))
+            ++*objects;
+        else
+            ++*miniObjects;
+    }
+
+    gst_structure_free(liveObjects);
+}
+
+// API enable/disable emulation
+gboolean Toggle(gpointer userData)
+{
+    Soak* soak = static_cast<Soak*>(userData);
+    StreamerControl* control = soak->control;
+    const unsigned streams = soak->options->streams;
+
+    ConfigChanges changes;
+    for(gint i = 0; i < soak->options->toggles; ++i) {
+        const std::string id = std::to_string(g_random_int_range(0, streams));
+        if(changes.reStreamersChanges.count(id))
+            continue;
+
+        const bool enabled = !control->config().reStreamers.at(id).enabled;
+        changes.reStreamersChanges[id].enabled = enabled;
+        if(enabled)
+            ++soak->cycles;
+    }
+
+    control->applyChanges(changes);
+
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean TakeSample(gpointer userData)
+{
+    Soak* soak = static_cast<Soak*>(userData);
+
+    Sample sample { .stats = SampleProcessStats() };
+    CountLiveObjects(soak->leaksTracer, &sample.gstObjects, &sample.gstMiniObjects);
+
+    const BenchTotals totals = CollectBenchTotals(*soak->control);
+    const double time = (sample.stats.time - soak->startTime) / 1000000.;
+    const bool warmedUp = time >= soak->options->warmup;
+
+    printf(
+        "{\"time_s\": %.0f, \"warmed_up\": %s, \"rss_kb\": %lu, \"heap_in_use_kb\": %lu, \"heap_free_kb\": %lu, "
+        "\"fds\": %lu, \"threads\": %lu, \"gst_objects\": %" G_GINT64_FORMAT ", "
+        "\"gst_mini_objects\": %" G_GINT64_FORMAT ", \"reStreamers\": %u, \"streaming\": %u, "
+        "\"ingests\": %u, \"restarts\": %u, \"cycles\": %" G_GUINT64_FORMAT "}\n",
+        time,
+        warmedUp ? "true" : "false",
+        sample.stats.rss,
+        sample.stats.heapInUse,
+        sample.stats.heapFree,
+        sample.stats.fds,
+        sample.stats.threads,
+        sample.gstObjects,
+        sample.gstMiniObjects,
+        totals.reStreamers,
+        totals.streaming,
+        totals.ingests,
+        totals.restarts,
+        soak->cycles);
+    fflush(stdout);
+
+    if(warmedUp)
+        soak->samples.push_back(sample);
+
+    if(time >= soak->options->duration) {
+        g_main_loop_quit(soak->loop);
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+// difference between means of the last and the first quarter of samples
+template<typename Value>
+double Growth(const std::deque<Sample>& samples, Value value)
+{
+    const size_t quarter = samples.size() / 4;
+
+    double first = 0;
+    double last = 0;
+    for(size_t i = 0; i < quarter; ++i) {
+        first += value(samples[i]);
+        last += value(samples[samples.size() - quarter + i]);
+    }
+
+    return (last - first) / quarter;
+}
+
+// returns true if no leak or fragmentation was detected
+bool PrintSummary(const Soak& soak, const BenchTotals& totals)
+{
+    const Options& options = *soak.options;
+    const std::deque<Sample>& samples = soak.samples;
+    if(samples.size() < MIN_SAMPLES) {
+        fprintf(stderr, "Not enough samples after warmup. Increase duration.\n");
+        return false;
+    }
+
+    const double rssGrowth = Growth(samples, [] (const Sample& s) { return s.stats.rss; });
+    const double heapInUseGrowth = Growth(samples, [] (const Sample& s) { return s.stats.heapInUse; });
+    const double heapFreeGrowth = Growth(samples, [] (const Sample& s) { return s.stats.heapFree; });
+    const double fdGrowth = Growth(samples, [] (const Sample& s) { return s.stats.fds; });
+    const double threadGrowth = Growth(samples, [] (const Sample& s) { return s.stats.threads; });
+    const bool objectsKnown = samples.front().gstObjects >= 0;
+    const double objectGrowth = objectsKnown ?
+        Growth(samples, [] (const Sample& s) { return s.gstObjects; }) : 0;
+    const double miniObjectGrowth = objectsKnown ?
+        Growth(samples, [] (const Sample& s) { return s.gstMiniObjects; }) : 0;
+
+    // RSS growing while allocated heap doesn't is held by free chunks malloc can't return
+    const bool heapKnown = samples.front().stats.heapInUse > 0;
+    const bool rssGrows = rssGrowth > options.maxRssGrowth;
+    const bool fragmentation = rssGrows && heapKnown && heapInUseGrowth < rssGrowth / 2;
+    const bool leak =
+        (rssGrows && !fragmentation) ||
+        objectGrowth > options.maxObjectGrowth ||
+        fdGrowth > options.maxFdGrowth ||
+        threadGrowth > options.maxThreadGrowth;
+
+    printf(
+        "{\"summary\": true, \"streams\": %d, \"duration_s\": %d, \"samples\": %zu, "
+        "\"restarts\": %u, \"cycles\": %" G_GUINT64_FORMAT ", "
+        "\"rss_growth_kb\": %.0f, \"heap_in_use_growth_kb\": %.0f, \"heap_free_growth_kb\": %.0f, "
+        "\"fd_growth\": %.1f, \"thread_growth\": %.1f, \"gst_objects_tracked\": %s, "
+        "\"gst_object_growth\": %.1f, \"gst_mini_object_growth\": %.1f, "
+        "\"leak\": %s, \"fragmentation\": %s}\n",
+        options.streams,
+        options.duration,
+        samples.size(),
+        totals.restarts,
+        soak.cycles,
+        rssGrowth,
+        heapInUseGrowth,
+        heapFreeGrowth,
+        fdGrowth,
+        threadGrowth,
+        objectsKnown ? "true" : "false",
+        objectGrowth,
+        miniObjectGrowth,
+        leak ? "true" : "false",
+        fragmentation ? "true" : "false");
+    fflush(stdout);
+
+    if(leak)
+        fprintf(stderr, "Resources grow over time. Possible leak.\n");
+    if(fragmentation)
+        fprintf(stderr, "RSS grows while allocated heap doesn't. Possible heap fragmentation.\n");
+
+    return !leak && !fragmentation;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    GOptionEntry optionEntries[] = {
+        { "streams", 's', 0, G_OPTION_ARG_INT, &options.streams,
+            "ReStreamers count", "COUNT" },
+        { "duration", 'd', 0, G_OPTION_ARG_INT, &options.duration,
+            "Seconds to run", "SECONDS" },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &options.warmup,
+            "Seconds before samples are taken into account", "SECONDS" },
+        { "drop-interval", 0, 0, G_OPTION_ARG_INT, &options.dropInterval,
+            "Seconds between disconnects of all sources, 0 - never", "SECONDS" },
+        { "toggles", 0, 0, G_OPTION_ARG_INT, &options.toggles,
+            "ReStreamers disabled or enabled back every second", "COUNT" },
+        { "sample-interval", 0, 0, G_OPTION_ARG_INT, &options.sampleInterval,
+            "Seconds between samples", "SECONDS" },
+        { "max-rss-growth", 0, 0, G_OPTION_ARG_INT, &options.maxRssGrowth,
+            "Allowed RSS growth", "KB" },
+        { "max-object-growth", 0, 0, G_OPTION_ARG_INT, &options.maxObjectGrowth,
+            "Allowed growth of live GstObjects count", "COUNT" },
+        { "max-fd-growth", 0, 0, G_OPTION_ARG_INT, &options.maxFdGrowth,
+            "Allowed growth of open fds count", "COUNT" },
+        { "max-thread-growth", 0, 0, G_OPTION_ARG_INT, &options.maxThreadGrowth,
+            "Allowed growth of threads count", "COUNT" },
+        { "workers", 0, 0, G_OPTION_ARG_INT, &options.workers,
+            "Threads for pipelines bus handling", "COUNT" },
+        { nullptr }
+    };
+
+    g_autoptr(GOptionContext) optionContext = g_option_context_new(nullptr);
+    g_option_context_add_main_entries(optionContext, optionEntries, nullptr);
+    g_autoptr(GError) error = nullptr;
+    if(!g_option_context_parse(optionContext, &argc, &argv, &error) ||
+        options.streams <= 0 || options.duration <= 0 || options.warmup < 0 ||
+        options.dropInterval < 0 || options.toggles < 0 || options.sampleInterval <= 0 || options.workers < 0)
+    {
+        fprintf(stderr, "%s\n", error ? error->message : "Wrong option value");
+        return EXIT_FAILURE;
+    }
+
+    // has to be forked before any GStreamer usage
+    SyntheticSource source(
+        SyntheticSource::Options {
+            .mounts = static_cast<unsigned>(options.streams),
+            .dropInterval = static_cast<unsigned>(options.dropInterval),
+        });
+    if(!source.start()) {
+        fprintf(stderr, "Failed to start synthetic source\n");
+        return EXIT_FAILURE;
+    }
+
+    // live objects are counted by leaks tracer, it has to be set before gst_init()
+    g_setenv("GST_TRACERS", "leaks", FALSE);
+
+    gst_init(&argc, &argv);
+    InitReStreamerLogger(spdlog::level::warn);
+
+    GstTracer* leaksTracer = FindLeaksTracer();
+    if(!leaksTracer)
+        fprintf(stderr, "Leaks tracer is not active, live GstObjects are not counted\n");
+
+    Config config;
+    config.workerThreads = options.workers;
+    for(gint i = 0; i < options.streams; ++i)
+        AddBenchReStreamer(&config, std::to_string(i), source.url(i), TargetUrl);
+
+    GMainLoop* loop = g_main_loop_new(nullptr, FALSE);
+    StreamerControl control(config, StreamerControl::SourceRemoved());
+
+    Soak soak {
+        .options = &options,
+        .loop = loop,
+        .control = &control,
+        .leaksTracer = leaksTracer,
+        .startTime = g_get_monotonic_time(),
+    };
+
+    control.admitReStreamers();
+
+    g_timeout_add_seconds(TOGGLE_INTERVAL, Toggle, &soak);
+    g_timeout_add_seconds(options.sampleInterval, TakeSample, &soak);
+
+    g_main_loop_run(loop);
+
+    const bool success = PrintSummary(soak, CollectBenchTotals(control));
+
+    if(leaksTracer)
+        gst_object_unref(leaksTracer);
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,351 @@
+#include "SyntheticSource.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/app/gstappsink.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+#include <CxxPtr/GstPtr.h>
+
+#include "Timecode.h"
+
+
+namespace {
+
+enum {
+    LOOP_DURATION = 4, // seconds
+    KEYFRAME_INTERVAL = 2, // seconds, loop has to start from keyframe
+    AUDIO_RATE = 44100,
+    AAC_FRAME_SAMPLES = 1024,
+    PUSH_INTERVAL = 5, // ms
+};
+
+const char* const AacEncoders[] = { "fdkaacenc", "avenc_aac", "voaacenc", "faac" };
+
+struct EncodedLoop
+{
+    std::deque<GstSamplePtr> video;
+    std::deque<GstSamplePtr> audio;
+};
+
+struct Output
+{
+    GstElementPtr videoSrcPtr;
+    GstElementPtr audioSrcPtr; // nullptr if there is no audio
+};
+
+struct Server
+{
+    EncodedLoop loop;
+
+    std::mutex outputsMutex;
+    std::map<GstRTSPMedia*, Output> outputs;
+};
+
+const char* FindAacEncoder()
+{
+    for(const char* encoder: AacEncoders) {
+        if(GstElementFactory* factory = gst_element_factory_find(encoder)) {
+            gst_object_unref(factory);
+            return encoder;
+        }
+    }
+
+    return nullptr;
+}
+
+void PullSamples(GstElement* pipeline, const char* sinkName, std::deque<GstSamplePtr>* samples)
+{
+    GstElementPtr sinkPtr(gst_bin_get_by_name(GST_BIN(pipeline), sinkName));
+    if(!sinkPtr)
+        return;
+
+    // appsink queue is unlimited by default, so branches don't block each other
+    while(GstSample* sample = gst_app_sink_pull_sample(GST_APP_SINK(sinkPtr.get())))
+        samples->emplace_back(sample);
+}
+
+bool EncodeLoop(
+    const SyntheticSource::Options& options,
+    const char* aacEncoder,
+    EncodedLoop* loop)
+{
+    g_autofree gchar* videoBranch = g_strdup_printf(
+        "videotestsrc pattern=smpte num-buffers=%u ! "
+        "video/x-raw,width=%u,height=%u,framerate=%u/1 ! "
+        "x264enc tune=zerolatency speed-preset=ultrafast key-int-max=%u bitrate=%u ! "
+        "h264parse config-interval=-1 ! "
+        "video/x-h264,stream-format=byte-stream,alignment=au ! "
+        "appsink name=video sync=false",
+        LOOP_DURATION * options.framerate,
+        options.width, options.height, options.framerate,
+        KEYFRAME_INTERVAL * options.framerate,
+        options.bitrate);
+
+    g_autofree gchar* audioBranch = aacEncoder ?
+        g_strdup_printf(
+            "audiotestsrc wave=ticks samplesperbuffer=%u num-buffers=%u ! "
+            "audio/x-raw,rate=%u,channels=2 ! audioconvert ! %s ! aacparse ! "
+            "audio/mpeg,stream-format=raw ! "
+            "appsink name=audio sync=false",
+            AAC_FRAME_SAMPLES,
+            LOOP_DURATION * AUDIO_RATE / AAC_FRAME_SAMPLES,
+            AUDIO_RATE,
+            aacEncoder) :
+        g_strdup("");
+
+    g_autofree gchar* description = g_strconcat(videoBranch, " ", audioBranch, nullptr);
+
+    g_autoptr(GError) error = nullptr;
+    GstElementPtr pipelinePtr(gst_parse_launch(description, &error));
+    GstElement* pipeline = pipelinePtr.get();
+    if(error) {
+        fprintf(stderr, "Failed to create encoding pipeline: %s\n", error->message);
+        return false;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    PullSamples(pipeline, "video", &loop->video);
+    PullSamples(pipeline, "audio", &loop->audio);
+
+    g_autoptr(GstBus) bus = gst_element_get_bus(pipeline);
+    g_autoptr(GstMessage) errorMessage = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+
+    if(errorMessage || loop->video.empty()) {
+        fprintf(stderr, "Failed to encode test pattern\n");
+        return false;
+    }
+
+    return true;
+}
+
+void MediaUnprepared(GstRTSPMedia* media, gpointer userData)
+{
+    Server* server = static_cast<Server*>(userData);
+
+    std::lock_guard lock(server->outputsMutex);
+    server->outputs.erase(media);
+}
+
+void MediaConfigure(GstRTSPMediaFactory*, GstRTSPMedia* media, gpointer userData)
+{
+    Server* server = static_cast<Server*>(userData);
+
+    GstElementPtr elementPtr(gst_rtsp_media_get_element(media));
+    GstBin* bin = GST_BIN(elementPtr.get());
+
+    Output output {
+        .videoSrcPtr = GstElementPtr(gst_bin_get_by_name_recurse_up(bin, "video")),
+        .audioSrcPtr = GstElementPtr(gst_bin_get_by_name_recurse_up(bin, "audio")),
+    };
+
+    g_signal_connect(media, "unprepared", G_CALLBACK(MediaUnprepared), server);
+
+    std::lock_guard lock(server->outputsMutex);
+    server->outputs.emplace(media, std::move(output));
+}
+
+void Push(Server* server, GstElementPtr Output::* srcPtr, GstBuffer* sourceBuffer, GstCaps* caps)
+{
+    std::lock_guard lock(server->outputsMutex);
+    for(const auto& pair: server->outputs) {
+        GstElement* appSrc = (pair.second.*srcPtr).get();
+        if(!appSrc)
+            continue;
+
+        // shallow copy, timestamps are assigned by appsrc on push
+        GstBuffer* buffer = gst_buffer_copy(sourceBuffer);
+        GST_BUFFER_PTS(buffer) = GST_CLOCK_TIME_NONE;
+        GST_BUFFER_DTS(buffer) = GST_CLOCK_TIME_NONE;
+
+        gst_app_src_set_caps(GST_APP_SRC(appSrc), caps);
+        gst_app_src_push_buffer(GST_APP_SRC(appSrc), buffer);
+    }
+}
+
+void PushVideo(Server* server, bool timecode, GstSample* sample)
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    GstCaps* caps = gst_sample_get_caps(sample);
+
+    if(timecode) {
+        // the time frame leaves the source
+        g_autoptr(GstBuffer) timecodedBuffer = InsertTimecode(buffer, TimecodeNow());
+        Push(server, &Output::videoSrcPtr, timecodedBuffer, caps);
+    } else {
+        Push(server, &Output::videoSrcPtr, buffer, caps);
+    }
+}
+
+// loops encoded frames in real time
+void PushLoop(Server* server, unsigned framerate, bool timecode)
+{
+    const EncodedLoop& loop = server->loop;
+
+    const gint64 startTime = g_get_monotonic_time();
+    guint64 videoFrames = 0;
+    guint64 audioFrames = 0;
+    for(;;) {
+        const GstClockTime elapsed = (g_get_monotonic_time() - startTime) * GST_USECOND;
+
+        while(gst_util_uint64_scale(videoFrames, GST_SECOND, framerate) <= elapsed) {
+            PushVideo(server, timecode, loop.video[videoFrames % loop.video.size()].get());
+            ++videoFrames;
+        }
+
+        while(!loop.audio.empty() &&
+            gst_util_uint64_scale(audioFrames, AAC_FRAME_SAMPLES * GST_SECOND, AUDIO_RATE) <= elapsed)
+        {
+            GstSample* sample = loop.audio[audioFrames % loop.audio.size()].get();
+            Push(server, &Output::audioSrcPtr, gst_sample_get_buffer(sample), gst_sample_get_caps(sample));
+            ++audioFrames;
+        }
+
+        g_usleep(PUSH_INTERVAL * 1000);
+    }
+}
+
+// runs in forked process until it's killed
+void RunServer(const SyntheticSource::Options& options, int readyFd)
+{
+    gst_init(nullptr, nullptr);
+
+    Server* server = new Server;
+
+    const char* aacEncoder = FindAacEncoder();
+    if(!aacEncoder)
+        fprintf(stderr, "AAC encoder is not available, sources will have no audio\n");
+
+    if(!EncodeLoop(options, aacEncoder, &server->loop)) {
+        dprintf(readyFd, "0 0\n");
+        return;
+    }
+
+    const bool hasAudio = !server->loop.audio.empty();
+
+    const gchar* mediaDescription = hasAudio ?
+        "( appsrc name=video is-live=true do-timestamp=true format=time ! "
+        "h264parse ! rtph264pay name=pay0 pt=96 config-interval=-1 "
+        "appsrc name=audio is-live=true do-timestamp=true format=time ! "
+        "aacparse ! rtpmp4gpay name=pay1 pt=97 )" :
+        "( appsrc name=video is-live=true do-timestamp=true format=time ! "
+        "h264parse ! rtph264pay name=pay0 pt=96 config-interval=-1 )";
+
+    GstRTSPServer* rtspServer = gst_rtsp_server_new();
+    gst_rtsp_server_set_address(rtspServer, "127.0.0.1");
+    gst_rtsp_server_set_service(rtspServer, "0");
+
+    g_autoptr(GstRTSPMountPoints) mountPoints = gst_rtsp_server_get_mount_points(rtspServer);
+    for(unsigned i = 0; i < options.mounts; ++i) {
+        GstRTSPMediaFactory* factory = gst_rtsp_media_factory_new();
+        gst_rtsp_media_factory_set_launch(factory, mediaDescription);
+        g_signal_connect(factory, "media-configure", G_CALLBACK(MediaConfigure), server);
+
+        g_autofree gchar* path = g_strdup_printf("/source%u", i);
+        gst_rtsp_mount_points_add_factory(mountPoints, path, factory);
+    }
+
+    if(!gst_rtsp_server_attach(rtspServer, nullptr)) {
+        fprintf(stderr, "Failed to start RTSP server\n");
+        dprintf(readyFd, "0 0\n");
+        return;
+    }
+
+    if(options.dropInterval) {
+        // emulates source failures
+        auto dropClients =
+            [] (gpointer userData) -> gboolean {
+                GstRTSPServer* rtspServer = static_cast<GstRTSPServer*>(userData);
+                GList* clients = gst_rtsp_server_client_filter(
+                    rtspServer,
+                    [] (GstRTSPServer*, GstRTSPClient*, gpointer) {
+                        return GST_RTSP_FILTER_REMOVE;
+                    },
+                    nullptr);
+                g_list_free_full(clients, g_object_unref);
+                return G_SOURCE_CONTINUE;
+            };
+        g_timeout_add_seconds(options.dropInterval, GSourceFunc(dropClients), rtspServer);
+    }
+
+    dprintf(readyFd, "%d %d\n", gst_rtsp_server_get_bound_port(rtspServer), hasAudio ? 1 : 0);
+    close(readyFd);
+
+    std::thread(PushLoop, server, options.framerate, options.timecode).detach();
+
+    GMainLoop* loop = g_main_loop_new(nullptr, FALSE);
+    g_main_loop_run(loop);
+}
+
+}
+
+SyntheticSource::SyntheticSource(const Options& options) :
+    _options(options)
+{
+}
+
+SyntheticSource::~SyntheticSource()
+{
+    if(_pid > 0) {
+        kill(_pid, SIGTERM);
+        waitpid(_pid, nullptr, 0);
+    }
+}
+
+bool SyntheticSource::start() noexcept
+{
+    int readyFds[2];
+    if(pipe(readyFds) != 0)
+        return false;
+
+    const pid_t pid = fork();
+    if(pid < 0) {
+        close(readyFds[0]);
+        close(readyFds[1]);
+        return false;
+    }
+
+    if(pid == 0) {
+        close(readyFds[0]);
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        RunServer(_options, readyFds[1]);
+        _exit(EXIT_FAILURE);
+    }
+
+    close(readyFds[1]);
+    _pid = pid;
+
+    FILE* ready = fdopen(readyFds[0], "r");
+    int hasAudio = 0;
+    if(!ready || fscanf(ready, "%u %d", &_port, &hasAudio) != 2)
+        _port = 0;
+    if(ready)
+        fclose(ready);
+    else
+        close(readyFds[0]);
+
+    _hasAudio = hasAudio != 0;
+
+    return _port != 0;
+}
+
+std::string SyntheticSource::url(unsigned mount) const
+{
+    g_autofree gchar* url = g_strdup_printf("rtsp://127.0.0.1:%u/source%u", _port, mount);
+    return url;
+}
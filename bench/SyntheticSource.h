@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+#include <sys/types.h>
+
+
+// Local RTSP server with synthetic H.264 + AAC sources for benchmarks.
+// A few seconds of test pattern are encoded once on start
+// and the same encoded frames are looped in real time to every mount,
+// so adding sources costs almost nothing besides RTP packetization.
+// Server lives in forked process to keep its CPU and memory usage
+// out of measurements, so it has to be started before gst_init() in the caller.
+class SyntheticSource
+{
+public:
+    struct Options
+    {
+        unsigned mounts = 1; // served as "/source0".."/source{mounts - 1}"
+        unsigned width = 640;
+        unsigned height = 360;
+        unsigned framerate = 25;
+        unsigned bitrate = 1000; // kbit/s
+        bool timecode = false; // embed TimecodeNow() into every video frame on push
+        unsigned dropInterval = 0; // seconds between disconnects of all clients, 0 - never
+    };
+
+    explicit SyntheticSource(const Options&);
+    ~SyntheticSource();
+
+    // forks server process and waits until it's listening
+    bool start() noexcept;
+
+    bool hasAudio() const { return _hasAudio; } // AAC encoder was available
+    std::string url(unsigned mount) const;
+
+private:
+    const Options _options;
+
+    pid_t _pid = -1;
+    unsigned _port = 0;
+    bool _hasAudio = false;
+};
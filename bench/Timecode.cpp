@@ -0,0 +1,180 @@
+#include "Timecode.h"
+
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+enum {
+    NAL_SLICE = 1,
+    NAL_IDR_SLICE = 5,
+    NAL_SEI = 6,
+    SEI_USER_DATA_UNREGISTERED = 5,
+    TIMECODE_SIZE = 8,
+};
+
+const guint8 TimecodeUuid[16] = {
+    0x52, 0x65, 0x53, 0x74, 0x72, 0x65, 0x61, 0x6d,
+    0x65, 0x72, 0x54, 0x69, 0x6d, 0x65, 0x63, 0x64,
+};
+
+// inserts emulation prevention bytes
+void AppendEscaped(const std::vector<guint8>& rbsp, std::vector<guint8>* nal)
+{
+    unsigned zeros = 0;
+    for(guint8 byte: rbsp) {
+        if(zeros >= 2 && byte <= 3) {
+            nal->push_back(3);
+            zeros = 0;
+        }
+
+        nal->push_back(byte);
+        zeros = byte == 0 ? zeros + 1 : 0;
+    }
+}
+
+// removes emulation prevention bytes
+std::vector<guint8> Unescape(const guint8* data, gsize size)
+{
+    std::vector<guint8> rbsp;
+    rbsp.reserve(size);
+
+    unsigned zeros = 0;
+    for(gsize i = 0; i < size; ++i) {
+        if(zeros >= 2 && data[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+
+        rbsp.push_back(data[i]);
+        zeros = data[i] == 0 ? zeros + 1 : 0;
+    }
+
+    return rbsp;
+}
+
+std::vector<guint8> TimecodeSei(GstClockTime timecode)
+{
+    std::vector<guint8> rbsp;
+    rbsp.push_back(SEI_USER_DATA_UNREGISTERED);
+    rbsp.push_back(sizeof(TimecodeUuid) + TIMECODE_SIZE);
+    rbsp.insert(rbsp.end(), std::begin(TimecodeUuid), std::end(TimecodeUuid));
+    for(int shift = (TIMECODE_SIZE - 1) * 8; shift >= 0; shift -= 8)
+        rbsp.push_back((timecode >> shift) & 0xff);
+    rbsp.push_back(0x80); // rbsp trailing bits
+
+    std::vector<guint8> nal = { 0, 0, 0, 1, NAL_SEI };
+    AppendEscaped(rbsp, &nal);
+
+    return nal;
+}
+
+// returns offset of the start code of the first slice, size if there is no slice
+gsize FirstSliceOffset(const guint8* data, gsize size)
+{
+    for(gsize i = 0; i + 3 < size; ++i) {
+        if(data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1)
+            continue;
+
+        const guint8 nalType = data[i + 3] & 0x1f;
+        if(nalType == NAL_SLICE || nalType == NAL_IDR_SLICE)
+            return i > 0 && data[i - 1] == 0 ? i - 1 : i;
+    }
+
+    return size;
+}
+
+GstClockTime ParseSei(const guint8* nal, gsize size)
+{
+    const std::vector<guint8> rbsp = Unescape(nal + 1, size - 1);
+
+    gsize offset = 0;
+    while(offset < rbsp.size() && rbsp[offset] != 0x80) {
+        unsigned payloadType = 0;
+        while(offset < rbsp.size() && rbsp[offset] == 0xff)
+            payloadType += rbsp[offset++];
+        if(offset >= rbsp.size())
+            break;
+        payloadType += rbsp[offset++];
+
+        unsigned payloadSize = 0;
+        while(offset < rbsp.size() && rbsp[offset] == 0xff)
+            payloadSize += rbsp[offset++];
+        if(offset >= rbsp.size())
+            break;
+        payloadSize += rbsp[offset++];
+
+        if(offset + payloadSize > rbsp.size())
+            break;
+
+        const guint8* payload = rbsp.data() + offset;
+        if(payloadType == SEI_USER_DATA_UNREGISTERED &&
+            payloadSize == sizeof(TimecodeUuid) + TIMECODE_SIZE &&
+            memcmp(payload, TimecodeUuid, sizeof(TimecodeUuid)) == 0)
+        {
+            GstClockTime timecode = 0;
+            for(unsigned i = 0; i < TIMECODE_SIZE; ++i)
+                timecode = (timecode << 8) | payload[sizeof(TimecodeUuid) + i];
+            return timecode;
+        }
+
+        offset += payloadSize;
+    }
+
+    return GST_CLOCK_TIME_NONE;
+}
+
+}
+
+GstClockTime TimecodeNow() noexcept
+{
+    return g_get_monotonic_time() * GST_USECOND;
+}
+
+GstBuffer* InsertTimecode(GstBuffer* accessUnit, GstClockTime timecode) noexcept
+{
+    GstMapInfo mapInfo;
+    if(!gst_buffer_map(accessUnit, &mapInfo, GST_MAP_READ))
+        return gst_buffer_ref(accessUnit);
+
+    const std::vector<guint8> sei = TimecodeSei(timecode);
+    const gsize offset = FirstSliceOffset(mapInfo.data, mapInfo.size);
+
+    GstBuffer* buffer = gst_buffer_new_allocate(nullptr, mapInfo.size + sei.size(), nullptr);
+    gst_buffer_fill(buffer, 0, mapInfo.data, offset);
+    gst_buffer_fill(buffer, offset, sei.data(), sei.size());
+    gst_buffer_fill(buffer, offset + sei.size(), mapInfo.data + offset, mapInfo.size - offset);
+
+    gst_buffer_unmap(accessUnit, &mapInfo);
+
+    gst_buffer_copy_into(
+        buffer,
+        accessUnit,
+        GstBufferCopyFlags(GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS),
+        0, -1);
+
+    return buffer;
+}
+
+GstClockTime FindTimecode(const guint8* data, gsize size) noexcept
+{
+    gsize offset = 0;
+    while(offset + 4 <= size) {
+        const gsize nalSize = GST_READ_UINT32_BE(data + offset);
+        offset += 4;
+        if(nalSize == 0 || offset + nalSize > size)
+            break;
+
+        const guint8* nal = data + offset;
+        if((nal[0] & 0x1f) == NAL_SEI) {
+            const GstClockTime timecode = ParseSei(nal, nalSize);
+            if(GST_CLOCK_TIME_IS_VALID(timecode))
+                return timecode;
+        }
+
+        offset += nalSize;
+    }
+
+    return GST_CLOCK_TIME_NONE;
+}
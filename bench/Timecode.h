@@ -0,0 +1,21 @@
+#pragma once
+
+#include <gst/gst.h>
+
+
+// Clock time carried inside H.264 access units
+// as "user data unregistered" SEI message,
+// so latency can be measured across processes of the same host
+// without decoding video.
+
+// monotonic clock shared by all processes of the host
+GstClockTime TimecodeNow() noexcept;
+
+// returns new buffer (transfer full) with timecode SEI inserted
+// before the first slice of byte-stream access unit
+GstBuffer* InsertTimecode(GstBuffer* accessUnit, GstClockTime timecode) noexcept;
+
+// looks for timecode SEI in access unit of NAL units
+// prefixed with 4 bytes length (AVC, as inside FLV video tag).
+// returns GST_CLOCK_TIME_NONE if there is no timecode
+GstClockTime FindTimecode(const guint8* data, gsize size) noexcept;
@@ -1,6 +1,13 @@
 #include <string>
 #include <deque>
 #include <optional>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <csignal>
+
+#include <glib-unix.h>
+#include <gio/gio.h>
 
 #include <gst/gst.h>
 
@@ -11,21 +18,28 @@
 #include "WebRTSP/Signalling/Config.h"
 #include "WebRTSP/Signalling/WsServer.h"
 #include "WebRTSP/Signalling/ServerSession.h"
-#include "WebRTSP/RtStreaming/GstRtStreaming/GstReStreamer2.h"
-
-#include <libconfig.h>
 
 #include "Log.h"
 #include "Defines.h"
 #include "Config.h"
+#include "ConfigPublisher.h"
+#include "ConfigWriter.h"
 #include "ConfigHelpers.h"
-#include "ReStreamer.h"
+#include "ConfigLoader.h"
+#include "StreamerIndex.h"
+#include "StreamerControl.h"
+#include "PreviewSource.h"
 #include "SSDP.h"
 #include "RestApi.h"
+#include "StreamerEvents.h"
 
 
 enum {
-    RECONNECT_INTERVAL = 5,
+    PREVIEW_IDLE_TIMEOUT = 30, // seconds without peers to destroy preview
+    STATS_UPDATE_INTERVAL = 1,
+    CONFIG_RELOAD_DELAY = 500, // ms, editors tend to write file in several steps
+    CONFIG_SAVE_DELAY = 1000, // ms
+    CONFIG_SAVE_MAX_DELAY = 5000, // ms
     DEFAULT_HTTP_PORT = 4080,
 };
 
@@ -34,528 +48,356 @@ static const auto Log = ReStreamerLog;
 
 namespace {
 
-#if VK_VIDEO_STREAMER
-const char* ConfigFileName = "vk-streamer.conf";
-const char* AppConfigFileName = "vk-streamer.app.conf";
-#elif YOUTUBE_LIVE_STREAMER
-const char* ConfigFileName = "live-streamer.conf";
-const char* AppConfigFileName = "live-streamer.app.conf";
-#else
-const char* ConfigFileName = "rtmp-streamer.conf";
-const char* AppConfigFileName = "rtmp-streamer.app.conf";
-#endif
+struct FileMonitorUnref
+{
+    void operator() (GFileMonitor* monitor)
+        { g_object_unref(monitor); }
+};
+typedef std::unique_ptr<GFileMonitor, FileMonitorUnref> FileMonitorPtr;
 
-G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(config_t, config_destroy)
+struct Preview {
+    std::unique_ptr<PreviewSource> source;
+    gint64 idleSince; // monotonic time (us), 0 - in use
+};
+typedef std::map<std::string, Preview> Previews; // sourceUrl -> Preview
+struct Context {
+    // owns running config, has to outlive previews
+    std::unique_ptr<StreamerControl> control;
+    std::unique_ptr<ConfigPublisher> configPublisher; // config snapshots for REST API threads
+    std::unique_ptr<ConfigWriter> configWriter; // saves app config
+    Previews previews; // created on demand of WebRTC peers
+
+    // snapshot of runtime state for REST API threads,
+    // accessed with std::atomic_* only
+    guint64 statsVersion = 0;
+    std::shared_ptr<const StatsSnapshot> stats;
+
+    // shared with HTTP connections streaming events
+    std::shared_ptr<StreamerEvents> events = std::make_shared<StreamerEvents>();
+
+    std::deque<FileMonitorPtr> configMonitors;
+    guint reloadTimeoutId = 0;
+
+    // startup progress
+    gint64 startupTime = 0; // monotonic time (us) reStreamers admission began at
+    std::set<std::string> startupPending; // enabled reStreamers not streaming since startup yet
+    gint64 startupDuration = -1; // us
+};
 
-std::optional<std::string>
-AppConfigPath()
+// reports time from startup till all enabled reStreamers were streaming at least once
+void UpdateStartupProgress(Context* context, const StatsSnapshot& stats)
 {
-#ifdef SNAPCRAFT_BUILD
-    if(const gchar* snapData = g_getenv("SNAP_DATA")) {
-        std::string configFile = snapData;
-        configFile += "/";
-        configFile += AppConfigFileName;
-        return configFile;
-    }
-#endif
+    std::set<std::string>& pending = context->startupPending;
+    if(pending.empty())
+        return;
 
-    const std::deque<std::string> configDirs = ::ConfigDirs();
-    if(!configDirs.empty())
-        return *configDirs.rbegin() + "/" + AppConfigFileName;
+    const auto& reStreamers = context->control->config().reStreamers;
+    for(auto it = pending.begin(); it != pending.end();) {
+        const auto configIt = reStreamers.find(*it);
+        const auto statsIt = stats.reStreamers.find(*it);
+        if(configIt == reStreamers.end() || !configIt->second.enabled ||
+            (statsIt != stats.reStreamers.end() && statsIt->second.streaming))
+        {
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
 
-    return {};
+    if(pending.empty()) {
+        context->startupDuration = stats.time - context->startupTime;
+        Log()->info(
+            "All reStreamers are live in {:.1f} s",
+            double(context->startupDuration) / G_USEC_PER_SEC);
+    }
 }
 
-inline std::string
-UserConfigPath(const std::string& userConfigDir)
+void UpdateStats(Context* context)
 {
-    return userConfigDir + "/" + ConfigFileName;
+    std::shared_ptr<StatsSnapshot> stats = std::make_shared<StatsSnapshot>();
+    stats->version = ++context->statsVersion;
+    stats->time = g_get_monotonic_time();
+    stats->restartStates = context->control->restartStates();
+    stats->reStreamers = context->control->stats();
+    UpdateStartupProgress(context, *stats);
+    stats->startupDuration = context->startupDuration;
+
+    std::shared_ptr<const StatsSnapshot> publishedStats(std::move(stats));
+    std::atomic_store(&context->stats, publishedStats);
+
+    context->events->update(context->configPublisher->snapshot(), publishedStats);
 }
 
-void SaveAppConfig(const Config& appConfig)
+std::shared_ptr<const StatsSnapshot> GetStats(Context* context)
 {
-    const std::optional<std::string>& targetPath = AppConfigPath();
-    if(!targetPath) return;
-
-    const auto& reStreamers = appConfig.reStreamers;
-
-    Log()->info("Writing config to \"{}\"", *targetPath);
-
-    g_auto(config_t) config;
-    config_init(&config);
-
-    config_setting_t* root = config_root_setting(&config);
-    config_setting_t* streamers = config_setting_add(root, "streamers", CONFIG_TYPE_LIST);
+    return std::atomic_load(&context->stats);
+}
 
-    for(auto it = reStreamers.begin(); it != reStreamers.end(); ++it) {
-        config_setting_t* streamer = config_setting_add(streamers, nullptr, CONFIG_TYPE_GROUP);
+// previews are created on the first peer only,
+// so sources without viewers don't cost anything except RTMP reStreaming
+PreviewSource* AcquirePreviewSource(Context* context, const std::string& sourceUrl)
+{
+    Previews& previews = context->previews;
 
-        config_setting_t* id = config_setting_add(streamer, "id", CONFIG_TYPE_STRING);
-        config_setting_set_string(id, it->first.c_str());
+    const auto previewIt = previews.find(sourceUrl);
+    if(previewIt != previews.end())
+        return previewIt->second.source.get();
 
-        config_setting_t* source = config_setting_add(streamer, "source", CONFIG_TYPE_STRING);
-        config_setting_set_string(source, it->second.sourceUrl.c_str());
+    const std::string* reStreamerId = context->control->index().findBySource(sourceUrl);
+    if(!reStreamerId)
+        return nullptr;
 
-        config_setting_t* target = config_setting_add(streamer, "target", CONFIG_TYPE_STRING);
-        config_setting_set_string(target, it->second.targetUrl.c_str());
-    }
+    const Config::ReStreamer& reStreamer = context->control->config().reStreamers.at(*reStreamerId);
+
+    Log()->info("Creating preview for \"{}\"...", sourceUrl);
+
+    const auto [it, inserted] = previews.emplace(
+        sourceUrl,
+        Preview {
+            std::make_unique<PreviewSource>(
+                sourceUrl,
+                reStreamer.forceH264ProfileLevelId,
+                [context, sourceUrl] (Ingest::Consumer* consumer) {
+                    context->control->acquireIngest(sourceUrl)->attach(consumer);
+                },
+                [context, sourceUrl] (Ingest::Consumer* consumer) {
+                    context->control->detachFromIngest(sourceUrl, consumer);
+                }),
+            0 });
+    assert(inserted);
 
-    if(!config_write_file(&config, targetPath->c_str())) {
-        Log()->error("Fail save config. {}. {}:{}",
-            config_error_text(&config),
-            *targetPath,
-            config_error_line(&config));
-    };
+    return it->second.source.get();
 }
 
-std::string BuildTargetUrl(
-    const Config& config,
-    const char* targetUrl,
-    const char* key)
+// called when source is not used by any reStreamer anymore
+void ReleasePreviewSource(Context* context, const std::string& sourceUrl)
 {
-#if VK_VIDEO_STREAMER || YOUTUBE_LIVE_STREAMER
-    std::string outTargetUrl(targetUrl ? std::string_view(targetUrl) : config.targetUrl);
-#else
-    std::string outTargetUrl = targetUrl;
-#endif
-
-    std::string::size_type placeholderPos = outTargetUrl.find(
-        Config::KeyPlaceholder.data(),
-        Config::KeyPlaceholder.size());
-    if(placeholderPos == std::string::npos) {
-        return outTargetUrl;
-    } else if(key) {
-        return outTargetUrl.replace(
-            placeholderPos,
-            Config::KeyPlaceholder.size(),
-            key);
-    } else {
-        assert(false);
-        return std::string();
-    }
+    context->previews.erase(sourceUrl);
 }
 
-std::map<std::string, Config::ReStreamer>::const_iterator
-FindStreamerId(
-    const Config& appConfig,
-    const std::string_view& sourceUrl,
-    const std::string& targetUrl)
+// grace period lets viewer reconnect (or reload page) without reconnecting to source
+void ReleaseIdlePreviews(Context* context)
 {
-    const auto& reStreamers = appConfig.reStreamers;
-
-    for(auto it = reStreamers.begin(); it != reStreamers.end(); ++it) {
-        const Config::ReStreamer& reStreamer = it->second;
-        if(reStreamer.sourceUrl == sourceUrl && reStreamer.targetUrl == targetUrl) {
-            return it;
+    Previews& previews = context->previews;
+
+    const gint64 now = g_get_monotonic_time();
+    for(auto it = previews.begin(); it != previews.end();) {
+        Preview& preview = it->second;
+        if(preview.source->inUse()) {
+            preview.idleSince = 0;
+        } else if(!preview.idleSince) {
+            preview.idleSince = now;
+        } else if(now - preview.idleSince >= PREVIEW_IDLE_TIMEOUT * G_USEC_PER_SEC) {
+            Log()->info("Destroying idle preview for \"{}\"...", it->first);
+            it = previews.erase(it);
+            continue;
         }
-    }
 
-    return reStreamers.end();
+        ++it;
+    }
 }
 
-void LoadStreamers(
-    const config_t& config,
-    Config* loadedConfig,
-    const Config* appConfig)
+// called from the main loop
+std::unique_ptr<WebRTCPeer> CreateWebRTCPeer(
+    Context* context,
+    const std::string& uri) noexcept
 {
-    const bool userConfigLoading = appConfig != nullptr;
-
-    auto& loadedReStreamers = loadedConfig->reStreamers;
-
-    config_setting_t* streamersConfig = config_lookup(&config, "streamers");
-    if(streamersConfig && CONFIG_TRUE == config_setting_is_list(streamersConfig)) {
-        const int streamersCount = config_setting_length(streamersConfig);
-        for(int streamerIdx = 0; streamerIdx < streamersCount; ++streamerIdx) {
-            config_setting_t* streamerConfig =
-                config_setting_get_elem(streamersConfig, streamerIdx);
-            if(!streamerConfig || CONFIG_FALSE == config_setting_is_group(streamerConfig)) {
-                Log()->warn("Wrong streamer config format. Streamer skipped.");
-                break;
-            }
-
-            const char* id = nullptr;
-            if(!userConfigLoading) {
-                config_setting_lookup_string(streamerConfig, "id", &id);
-            }
-            const char* source = nullptr;
-            config_setting_lookup_string(streamerConfig, "source", &source);
-            const char* target = nullptr;
-            config_setting_lookup_string(streamerConfig, "target", &target);
-            const char* description = "";
-            config_setting_lookup_string(streamerConfig, "description", &description);
-            const char* key = nullptr;
-#if YOUTUBE_LIVE_STREAMER
-            if(userConfigLoading) {
-                config_setting_lookup_string(streamerConfig, "youtube-stream-key", &key);
-            }
-#endif
-            config_setting_lookup_string(streamerConfig, "key", &key);
-            int enabled = TRUE;
-            config_setting_lookup_bool(streamerConfig, "enable", &enabled);
-
-            if(!source) {
-                Log()->warn("\"source\" property is empty. Streamer skipped.");
-                continue;
-            }
-
-            bool needsKey = true;
-            if(target) {
-                std::string_view targetView = target;
-                needsKey = targetView.find(
-                    Config::KeyPlaceholder.data(),
-                    Config::KeyPlaceholder.size()) != std::string_view::npos;
-#if VK_VIDEO_STREAMER || YOUTUBE_LIVE_STREAMER
-            } else if(loadedConfig->targetUrl.empty()) {
-#else
-            } else {
-#endif
-                Log()->warn("\"target\" property is missing. Streamer skipped.");
-                continue;
-            }
-
-            if(needsKey && (!key || key[0] == '\0')) {
-                Log()->warn("\"key\" property is missing. Streamer skipped.");
-                continue;
-            }
-
-            const std::string targetUrl = BuildTargetUrl(*loadedConfig, target, key);
-            if(loadedReStreamers.end() != FindStreamerId(*loadedConfig, source, targetUrl)) {
-                Log()->warn("Found streamer with duplicated \"source\" and \"key\" properties. Streamer skipped.");
-                continue;
-            }
-
-            if(appConfig) {
-                const auto it = FindStreamerId(*appConfig, source, targetUrl);
-                if(it != appConfig->reStreamers.end()) {
-                    id = it->first.c_str(); // use id generated on some previous launch
-                }
-            }
-
-            g_autofree gchar* uniqueId = nullptr;
-            if(!id) {
-                uniqueId = g_uuid_string_random();
-                id = uniqueId;
-            }
-
-            const auto& emplaceResult = loadedConfig->reStreamers.emplace(
-                id,
-                Config::ReStreamer {
-                    source,
-                    description,
-                    targetUrl,
-                    enabled != FALSE });
-            if(emplaceResult.second) {
-                loadedConfig->reStreamersOrder.emplace_back(emplaceResult.first->first);
-            }
-        }
-    }
+    if(PreviewSource* previewSource = AcquirePreviewSource(context, uri)) {
+        context->previews.at(uri).idleSince = 0;
+        return previewSource->createPeer();
+    } else
+        return nullptr;
 }
 
-bool LoadConfig(
-    http::Config* httpConfig,
-    signalling::Config* wsConfig,
-    Config* config)
+std::unique_ptr<ServerSession> CreateWebRTSPSession(
+    const WebRTCConfigPtr& webRTCConfig,
+    Context* context,
+    const rtsp::Session::SendRequest& sendRequest,
+    const rtsp::Session::SendResponse& sendResponse) noexcept
 {
-    const std::deque<std::string> configDirs = ::ConfigDirs();
-    if(configDirs.empty())
-        return false;
-
-    http::Config loadedHttpConfig = *httpConfig;
-    signalling::Config loadedWsConfig = *wsConfig;
-    Config loadedConfig = *config;
-    Config loadedAppConfig;
-
-    if(const auto& appConfigPath = AppConfigPath()) {
-        if(g_file_test(appConfigPath->c_str(), G_FILE_TEST_IS_REGULAR)) {
-            g_auto(config_t) config;
-            config_init(&config);
-
-            Log()->info("Loading config \"{}\"", *appConfigPath);
-            if(!config_read_file(&config, appConfigPath->c_str())) {
-                Log()->error("Fail load config. {}. {}:{}",
-                    config_error_text(&config),
-                    *appConfigPath,
-                    config_error_line(&config));
-                return false;
-            }
-
-            LoadStreamers(config, &loadedAppConfig, nullptr);
-        }
-    }
-
-    for(const std::string& configDir: configDirs) {
-        const std::string& configFile = UserConfigPath(configDir);
-        if(!g_file_test(configFile.c_str(),  G_FILE_TEST_IS_REGULAR)) {
-            Log()->info("Config \"{}\" not found", configFile);
-            continue;
-        }
-
-        g_auto(config_t) config;
-        config_init(&config);
-
-        Log()->info("Loading config \"{}\"", configFile);
-        if(!config_read_file(&config, configFile.c_str())) {
-            Log()->error("Fail load config. {}. {}:{}",
-                config_error_text(&config),
-                configFile,
-                config_error_line(&config));
-            return false;
-        }
-
-        int logLevel = 0;
-        if(CONFIG_TRUE == config_lookup_int(&config, "log-level", &logLevel)) {
-            if(logLevel > 0) {
-                loadedConfig.logLevel =
-                    static_cast<spdlog::level::level_enum>(
-                        spdlog::level::critical - std::min<int>(logLevel, spdlog::level::critical));
-            }
-        }
-
-        const char* wwwRoot = nullptr;
-        if(CONFIG_TRUE == config_lookup_string(&config, "www-root", &wwwRoot)) {
-            loadedHttpConfig.wwwRoot = wwwRoot;
-        }
-
-        int loopbackOnly = false;
-        if(CONFIG_TRUE == config_lookup_bool(&config, "loopback-only", &loopbackOnly)) {
-            loadedHttpConfig.bindToLoopbackOnly = loopbackOnly != false;
-        }
-
-        int httpPort;
-        if(CONFIG_TRUE == config_lookup_int(&config, "http-port", &httpPort)) {
-            loadedHttpConfig.port = static_cast<unsigned short>(httpPort);
-        }
-
-        int wsPort;
-        if(CONFIG_TRUE == config_lookup_int(&config, "ws-port", &wsPort)) {
-            loadedWsConfig.port = static_cast<unsigned short>(wsPort);
-        }
-
-        const char* source = nullptr;
-        config_lookup_string(&config, "source", &source);
-        const char* key = nullptr;
-        config_lookup_string(&config, "key", &key);
-
-        if(source && key) {
-            g_autofree gchar* uniqueId = g_uuid_string_random();
-            const auto& emplaceResult = loadedConfig.reStreamers.emplace(
-                uniqueId,
-                Config::ReStreamer {
-                    source,
-                    std::string(),
-                    BuildTargetUrl(loadedConfig, nullptr, key),
-                    true });
-            if(emplaceResult.second) {
-                loadedConfig.reStreamersOrder.emplace_back(emplaceResult.first->first);
-            }
-        }
-
-        LoadStreamers(config, &loadedConfig, &loadedAppConfig);
-    }
-
-    bool success = true;
-    if(loadedConfig.reStreamers.empty()) {
-        Log()->warn("No streamers configured");
-    }
+    return
+        std::make_unique<ServerSession>(
+            webRTCConfig,
+            std::bind(CreateWebRTCPeer, context, std::placeholders::_1),
+            sendRequest,
+            sendResponse);
+}
 
-    if(success) {
-        *httpConfig = loadedHttpConfig;
-        *config = loadedConfig;
+void ConfigChanged(Context* context, const std::unique_ptr<ConfigChanges>& changes)
+{
+    const Config& config = context->control->config();
 
-        SaveAppConfig(*config);
-    }
+    context->control->applyChanges(*changes);
 
-    assert(config->reStreamers.size() == config->reStreamersOrder.size());
+    context->configPublisher->publish(config);
 
-    return success;
+    context->configWriter->schedule(context->configPublisher->snapshot());
 }
 
-typedef std::map<std::string, ReStreamer> RTMPReStreamers;
-typedef std::map<std::string, std::unique_ptr<GstStreamingSource>> ReStreamers;
-struct Context {
-    Config config;
-    ReStreamers reStreamers;
-    RTMPReStreamers rtmpReStreamers;
-    std::map<std::string, guint> restarting; // reStreamerId -> timeout event source id
-};
-
-void StopReStream(Context* context, const std::string& reStreamerId)
+void AdmitReStreamers(Context* context)
 {
-    auto restartingIt = context->restarting.find(reStreamerId);
-    if(restartingIt != context->restarting.end()) {
-        Log()->info("Cancelling pending reStreaming restart for \"{}\"...", reStreamerId);
-        g_source_remove(restartingIt->second);
-        context->restarting.erase(restartingIt);
-    }
-
-    RTMPReStreamers* reStreamers = &(context->rtmpReStreamers);
-    const auto& it = reStreamers->find(reStreamerId);
-    if(it != reStreamers->end()) {
-        Log()->info("Stopping active reStreaming \"{}\" (\"{}\")...", it->second.sourceUrl(), reStreamerId);
-        reStreamers->erase(it);
-    }
+    const std::deque<std::string> startOrder = context->control->admitReStreamers();
 
+    context->startupTime = g_get_monotonic_time();
+    context->startupPending.insert(startOrder.begin(), startOrder.end());
+    if(startOrder.empty())
+        context->startupDuration = 0;
 }
 
-void ScheduleStartReStream(Context* context, const std::string& reStreamerId);
-
-void StartReStream(
-    Context* context,
-    const std::string& reStreamerId)
+// only added, removed and changed reStreamers are touched,
+// the rest keep streaming without interruption
+void ReloadConfig(Context* context)
 {
-    const Config& config = context->config;
-    RTMPReStreamers* reStreamers = &(context->rtmpReStreamers);
-
-    assert(reStreamers->find(reStreamerId) == reStreamers->end());
-    StopReStream(context, reStreamerId);
-
-    const auto configIt = config.reStreamers.find(reStreamerId);
-    if(configIt == config.reStreamers.end()) {
-        Log()->error("Can't find reStreamer with id \"{}\"", reStreamerId);
+    // HTTP and WebSocket servers, worker threads and restart policy
+    // are applied on application restart only
+    http::Config httpConfig;
+    signalling::Config wsConfig;
+    Config loadedConfig;
+    bool appConfigOutdated = false;
+    if(!LoadConfig(&httpConfig, &wsConfig, &loadedConfig, &appConfigOutdated)) {
+        Log()->error("Config reload failed. Keeping running config.");
         return;
     }
 
-    const Config::ReStreamer& reStreamerConfig = configIt->second;
-
-    const auto reStreamerIt = reStreamers->find(reStreamerId);
-
-    if(reStreamerConfig.enabled) {
-        if(reStreamerIt == reStreamers->end()) {
-            Log()->info("ReStreaming \"{}\" (\"{}\")", reStreamerConfig.sourceUrl, reStreamerId);
+    StreamerControl* control = context->control.get();
+    Config& config = control->config();
+
+    config.logLevel = loadedConfig.logLevel;
+    Log()->set_level(config.logLevel);
+
+    // reStreamers are matched by source and targets the same way as app config ids are,
+    // and by explicit id if source or targets were edited
+    const StreamerIndex runningIndex(config);
+    std::set<std::string> matchedIds;
+    std::deque<std::pair<std::string, const Config::ReStreamer*>> matched; // in loaded order
+    for(const std::string& loadedId: loadedConfig.reStreamersOrder) {
+        const Config::ReStreamer& loadedReStreamer = loadedConfig.reStreamers.at(loadedId);
+
+        std::optional<std::string> runningId;
+        const std::string* sameId =
+            runningIndex.find(loadedReStreamer.sourceUrl, loadedReStreamer.targetUrls);
+        if(sameId && matchedIds.count(*sameId) == 0)
+            runningId = *sameId;
+        else if(config.reStreamers.count(loadedId) != 0 && matchedIds.count(loadedId) == 0)
+            runningId = loadedId;
+
+        if(runningId) {
+            matchedIds.insert(*runningId);
+            matched.emplace_back(*runningId, &loadedReStreamer);
         } else {
-            Log()->warn(
-                "Ignoring reStreaming request for already reStreaming source \"{}\" (\"{}\")...",
-                reStreamerConfig.sourceUrl,
-                reStreamerId);
+            matched.emplace_back(std::string(), &loadedReStreamer);
         }
-    } else {
-        Log()->debug(
-            "Ignoring reStreaming request for disabled source \"{}\" (\"{}\")...",
-            reStreamerConfig.sourceUrl,
-            reStreamerId);
-        assert(reStreamerIt == reStreamers->end());
-        return;
     }
 
-    auto [it, inserted] = reStreamers->emplace(
-        std::piecewise_construct,
-        std::forward_as_tuple(reStreamerId),
-        std::forward_as_tuple(
-            reStreamerConfig.sourceUrl,
-            reStreamerConfig.targetUrl,
-            [context, reStreamerId] () {
-                // it's required to do reStreamerId copy
-                // since ReStreamer instance
-                // will be destroyed inside ScheduleStartReStream
-                // and as consequence current lambda with all captures
-                // will be destroyed too
-                ScheduleStartReStream(context, std::string(reStreamerId));
-            }
-        ));
-    assert(inserted);
-
-    it->second.start();
-}
+    unsigned removedCount = 0;
+    const std::deque<std::string> runningOrder = config.reStreamersOrder;
+    for(const std::string& runningId: runningOrder) {
+        if(matchedIds.count(runningId) != 0)
+            continue;
 
-void ScheduleStartReStream(
-    Context* context,
-    const std::string& reStreamerId)
-{
-    if(context->restarting.find(reStreamerId) != context->restarting.end()) {
-        Log()->debug("ReStreamer restart already pending. Ignoring new request...");
-        return;
+        control->removeReStreamer(runningId);
+        ++removedCount;
     }
 
-    Log()->info("ReStreaming restart pending...");
-
-    const Config& config = context->config;
-    RTMPReStreamers* reStreamers = &(context->rtmpReStreamers);
-
-    assert(reStreamers->find(reStreamerId) != reStreamers->end());
-    StopReStream(context, reStreamerId);
-
-    typedef std::tuple<
-        Context*,
-        std::string> Data;
-
-    auto reconnect =
-        [] (gpointer userData) -> gboolean {
-            const auto& [context, reStreamerId] = *reinterpret_cast<Data*>(userData);
-
-            context->restarting.erase(reStreamerId);
+    unsigned addedCount = 0;
+    unsigned changedCount = 0;
+    std::deque<std::string> order;
+    for(auto& [uniqueId, loadedReStreamer]: matched) {
+        if(uniqueId.empty()) {
+            g_autofree gchar* newId = g_uuid_string_random();
+            uniqueId = newId;
+            control->addReStreamer(uniqueId, *loadedReStreamer);
+            ++addedCount;
+        } else if(control->replaceReStreamer(uniqueId, *loadedReStreamer)) {
+            ++changedCount;
+        }
 
-            StartReStream(context, reStreamerId);
+        order.push_back(uniqueId);
+    }
+    config.reStreamersOrder = order;
 
-            return false;
-        };
+    assert(config.reStreamers.size() == config.reStreamersOrder.size());
 
-    const guint timeoutId = g_timeout_add_seconds_full(
-        G_PRIORITY_DEFAULT,
-        RECONNECT_INTERVAL,
-        GSourceFunc(reconnect),
-        new Data(context, reStreamerId),
-        [] (gpointer userData) {
-            delete reinterpret_cast<Data*>(userData);
-        });
+    Log()->info(
+        "Config reloaded. {} reStreamers added, {} removed, {} changed, {} unchanged",
+        addedCount,
+        removedCount,
+        changedCount,
+        config.reStreamers.size() - addedCount - changedCount);
 
-    context->restarting.emplace(reStreamerId, timeoutId);
-}
+    context->configPublisher->publish(config);
 
-static std::unique_ptr<WebRTCPeer> CreateWebRTCPeer(
-    const ReStreamers& reStreamers,
-    const std::string& uri) noexcept
-{
-    auto streamerIt = reStreamers.find(uri);
-    if(streamerIt != reStreamers.end()) {
-        return streamerIt->second->createPeer();
-    } else
-        return nullptr;
+    // ids of running reStreamers have to be kept
+    context->configWriter->schedule(context->configPublisher->snapshot());
 }
 
-std::unique_ptr<ServerSession> CreateWebRTSPSession(
-    const WebRTCConfigPtr& webRTCConfig,
-    const ReStreamers& reStreamers,
-    const rtsp::Session::SendRequest& sendRequest,
-    const rtsp::Session::SendResponse& sendResponse) noexcept
+void ScheduleReloadConfig(Context* context)
 {
-    return
-        std::make_unique<ServerSession>(
-            webRTCConfig,
-            std::bind(CreateWebRTCPeer, std::ref(reStreamers), std::placeholders::_1),
-            sendRequest,
-            sendResponse);
+    if(context->reloadTimeoutId)
+        g_source_remove(context->reloadTimeoutId);
+
+    context->reloadTimeoutId =
+        g_timeout_add(
+            CONFIG_RELOAD_DELAY,
+            [] (gpointer userData) -> gboolean {
+                Context* context = static_cast<Context*>(userData);
+                context->reloadTimeoutId = 0;
+                ReloadConfig(context);
+                return G_SOURCE_REMOVE;
+            },
+            context);
 }
 
-void ConfigChanged(Context* context, const std::unique_ptr<ConfigChanges>& changes)
+void WatchConfig(Context* context)
 {
-    Config& config = context->config;
+    g_unix_signal_add(
+        SIGHUP,
+        [] (gpointer userData) -> gboolean {
+            Log()->info("Got SIGHUP. Reloading config...");
+            ScheduleReloadConfig(static_cast<Context*>(userData));
+            return G_SOURCE_CONTINUE;
+        },
+        context);
+
+    auto onChanged =
+        [] (GFileMonitor*, GFile* file, GFile*, GFileMonitorEvent event, gpointer userData) {
+            switch(event) {
+                case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+                case G_FILE_MONITOR_EVENT_CREATED:
+                case G_FILE_MONITOR_EVENT_DELETED:
+                case G_FILE_MONITOR_EVENT_MOVED_IN:
+                case G_FILE_MONITOR_EVENT_RENAMED: {
+                    g_autofree gchar* path = g_file_get_path(file);
+                    Log()->info("Config \"{}\" changed. Reloading config...", path ? path : "");
+                    ScheduleReloadConfig(static_cast<Context*>(userData));
+                    break;
+                }
+                default:
+                    break;
+            }
+        };
 
-    const auto& reStreamersChanges = changes->reStreamersChanges;
-    for(const auto& pair: reStreamersChanges) {
-        const std::string& uniqueId = pair.first;
-        const ConfigChanges::ReStreamerChanges& reStreamerChanges = pair.second;
+    for(const std::string& configDir: ::ConfigDirs()) {
+        const std::string& configFile = UserConfigPath(configDir);
 
-        const auto& it = config.reStreamers.find(uniqueId);
-        if(it == config.reStreamers.end()) {
-            Log()->warn("Got change request for unknown reStreamer \"{}\"", uniqueId);
-            return;
+        g_autoptr(GFile) file = g_file_new_for_path(configFile.c_str());
+        g_autoptr(GError) error = nullptr;
+        // watching for renames too since a lot of editors save files by replacing them
+        FileMonitorPtr monitorPtr(
+            g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES, nullptr, &error));
+        if(!monitorPtr) {
+            Log()->warn("Failed to watch config \"{}\": {}", configFile, error->message);
+            continue;
         }
 
-        Config::ReStreamer& reStreamerConfig = it->second;
+        g_signal_connect(
+            monitorPtr.get(),
+            "changed",
+            G_CALLBACK(+onChanged),
+            context);
 
-        if(reStreamerChanges.enabled) {
-            if(reStreamerConfig.enabled != *reStreamerChanges.enabled) {
-                reStreamerConfig.enabled = *reStreamerChanges.enabled;
-                if(reStreamerConfig.enabled) {
-                    StartReStream(context, uniqueId);
-                } else {
-                    StopReStream(context, uniqueId);
-                }
-            }
-        }
+        context->configMonitors.emplace_back(std::move(monitorPtr));
     }
-
-    // FIXME? add config save to disk
 }
 
 void PostConfigChanges(Context* context, std::unique_ptr<ConfigChanges>&& changes)
@@ -600,26 +442,45 @@ int main(int argc, char *argv[])
     }
 #endif
 
-    if(!LoadConfig(&httpConfig, &wsConfig, &context.config))
+    Config config;
+    bool appConfigOutdated = false;
+    if(!LoadConfig(&httpConfig, &wsConfig, &config, &appConfigOutdated))
         return -1;
 
+    // before any thread could log
+    InitReStreamerLogger(config.logLevel);
+
 
     gst_init(&argc, &argv);
 
+    context.control =
+        std::make_unique<StreamerControl>(
+            config,
+            [context = &context] (const std::string& sourceUrl) {
+                ReleasePreviewSource(context, sourceUrl);
+            });
+    context.configPublisher = std::make_unique<ConfigPublisher>(config);
+    context.configWriter =
+        std::make_unique<ConfigWriter>(SaveAppConfig, CONFIG_SAVE_DELAY, CONFIG_SAVE_MAX_DELAY);
+    if(appConfigOutdated)
+        context.configWriter->schedule(context.configPublisher->snapshot());
+
     GMainLoopPtr loopPtr(g_main_loop_new(nullptr, FALSE));
     GMainLoop* loop = loopPtr.get();
 
-    for(const auto& pair: context.config.reStreamers) {
-        const std::string& uniqueId = pair.first;
-        const Config::ReStreamer& reStreamer = pair.second;
-        context.reStreamers.emplace(
-            reStreamer.sourceUrl,
-            std::make_unique<GstReStreamer2>(
-                reStreamer.sourceUrl,
-                reStreamer.forceH264ProfileLevelId));
+    g_timeout_add_seconds(
+        STATS_UPDATE_INTERVAL,
+        [] (gpointer userData) -> gboolean {
+            Context* context = static_cast<Context*>(userData);
+            UpdateStats(context);
+            ReleaseIdlePreviews(context);
+            return G_SOURCE_CONTINUE;
+        },
+        &context);
 
-        StartReStream(&context, uniqueId);
-    }
+    UpdateStats(&context); // REST API requires initial snapshot
+
+    WatchConfig(&context);
 
     std::unique_ptr<http::MicroServer> httpServerPtr;
     if(httpConfig.port) {
@@ -636,10 +497,14 @@ int main(int argc, char *argv[])
                 http::MicroServer::OnNewAuthToken(),
                 std::bind(
                     &rest::HandleRequest,
-                    std::make_shared<Config>(context.config),
+                    [configPublisher = context.configPublisher.get()] () {
+                        return configPublisher->snapshot();
+                    },
                     [context = &context] (std::unique_ptr<ConfigChanges>&& changes) {
                         PostConfigChanges(context, std::move(changes));
                     },
+                    std::bind(GetStats, &context),
+                    context.events,
                     std::placeholders::_1,
                     std::placeholders::_2,
                     std::placeholders::_3),
@@ -655,7 +520,7 @@ int main(int argc, char *argv[])
             std::bind(
                 CreateWebRTSPSession,
                 std::make_shared<WebRTCConfig>(),
-                std::ref(context.reStreamers),
+                &context,
                 std::placeholders::_1,
                 std::placeholders::_2));
         wsServerPtr->init();
@@ -693,7 +558,21 @@ int main(int argc, char *argv[])
     }
 #endif
 
+    // control plane is up already, so reStreamers progress is observable from the very beginning
+    AdmitReStreamers(&context);
+
+    // to not lose pending config changes on termination
+    auto quit =
+        [] (gpointer userData) -> gboolean {
+            g_main_loop_quit(static_cast<GMainLoop*>(userData));
+            return G_SOURCE_REMOVE;
+        };
+    g_unix_signal_add(SIGINT, quit, loop);
+    g_unix_signal_add(SIGTERM, quit, loop);
+
     g_main_loop_run(loop);
 
+    context.configWriter.reset(); // waits pending config write
+
     return 0;
 }
@@ -3,11 +3,19 @@ import { defineStore } from 'pinia'
 
 declare const APIPort: number
 
+interface StreamerStats {
+  fps?: number
+  kbps?: number
+  latency: number | null
+}
+
 interface Streamer {
   id: string
   description: string
   sourceUrl: string
   enabled: boolean
+  state: string
+  stats?: StreamerStats
   sendingUpdate: boolean
 }
 
@@ -16,7 +24,34 @@ export const useStreamersStore = defineStore('streamers', () => {
 
   const streamers = ref<Streamer[]>([])
 
-  const apiUrl = `${window.location.protocol}//${window.location.hostname}:${APIPort}/api/streamers`
+  const apiRoot = `${window.location.protocol}//${window.location.hostname}:${APIPort}/api`
+  const apiUrl = `${apiRoot}/streamers`
+  const eventsUrl = `${apiRoot}/events`
+
+  // eslint-disable-next-line @typescript-eslint/no-explicit-any
+  function toStreamer(inStreamer: any, sendingUpdate = false): Streamer {
+    return {
+      id: inStreamer.id,
+      description: inStreamer.description,
+      sourceUrl: inStreamer.source,
+      enabled: inStreamer.enabled,
+      state: inStreamer.state ?? "",
+      sendingUpdate: sendingUpdate,
+    }
+  }
+
+  function applyStats(stats: Record<string, StreamerStats>) {
+    for(const streamer of streamers.value)
+      streamer.stats = stats[streamer.id]
+  }
+
+  // deltas have stats of changed streamers only, null - streamer is not running anymore
+  function mergeStats(stats: Record<string, StreamerStats | null>) {
+    for(const streamer of streamers.value) {
+      if(streamer.id in stats)
+        streamer.stats = stats[streamer.id] ?? undefined
+    }
+  }
 
   async function fetchStreamers() {
     if(fetchingStreamers.value) return
@@ -27,15 +62,7 @@ export const useStreamersStore = defineStore('streamers', () => {
       if(!response.ok) return // FIXME?
 
       // eslint-disable-next-line @typescript-eslint/no-explicit-any
-      const fetchedStreamers = (await response.json()).map((inStreamer: any) => {
-        return {
-          id: inStreamer.id,
-          description: inStreamer.description,
-          sourceUrl: inStreamer.source,
-          enabled: inStreamer.enabled,
-          sendingUpdate: false,
-        }
-      })
+      const fetchedStreamers = (await response.json()).map((inStreamer: any) => toStreamer(inStreamer))
 
       streamers.value = fetchedStreamers
     } catch(error: unknown) {
@@ -45,6 +72,45 @@ export const useStreamersStore = defineStore('streamers', () => {
     }
   }
 
+  // server pushes full state on (re)connect and coalesced deltas after it,
+  // EventSource reconnects by itself
+  function subscribe() {
+    const events = new EventSource(eventsUrl)
+
+    events.addEventListener("full", (event: MessageEvent) => {
+      const data = JSON.parse(event.data)
+      // eslint-disable-next-line @typescript-eslint/no-explicit-any
+      streamers.value = data.streamers.map((inStreamer: any) => toStreamer(inStreamer))
+      applyStats(data.stats)
+    })
+
+    events.addEventListener("delta", (event: MessageEvent) => {
+      const data = JSON.parse(event.data)
+
+      if(data.removed) {
+        const removed = new Set<string>(data.removed)
+        streamers.value = streamers.value.filter((streamer) => !removed.has(streamer.id))
+      }
+
+      for(const inStreamer of data.changed ?? []) {
+        const index = streamers.value.findIndex((streamer) => streamer.id == inStreamer.id)
+        if(index < 0)
+          streamers.value.push(toStreamer(inStreamer))
+        else
+          streamers.value[index] = {
+            ...toStreamer(inStreamer, streamers.value[index].sendingUpdate),
+            stats: streamers.value[index].stats,
+          }
+      }
+
+      mergeStats(data.stats ?? {})
+    })
+
+    events.onerror = () => {
+      console.error("Streamers events stream error")
+    }
+  }
+
   async function toggleStreaming(streamerId: string) {
     const streamer = streamers.value.find((streamer) => streamer.id == streamerId)
     if(!streamer) return
@@ -69,7 +135,7 @@ export const useStreamersStore = defineStore('streamers', () => {
     }
   }
 
-  fetchStreamers()
+  subscribe()
 
   return { fetchingStreamers, fetchStreamers, streamers, toggleStreaming }
 })